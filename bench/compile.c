@@ -0,0 +1,106 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Measures the time needed to compile a translated page
+// The page is compiled as generated and with the standard I/O header
+// the generated prologue used to pull in through libhtmc.h
+// Must be run from the root of the repository
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "compile.h"
+#include "log.h"
+#include "parse.h"
+
+#define BENCH_ITERATIONS 20
+#define BENCH_SRC        "examples/index.htmc"
+#define BENCH_C          "tmp/bench-compile.c"
+#define BENCH_C_STDIO    "tmp/bench-compile-stdio.c"
+#define BENCH_SO         "tmp/bench-compile.so"
+#define BENCH_STDIO      "#include <stdio.h>\n"
+
+static double now() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int translate_page(const char *dst_path, const char *prefix) {
+  FILE *src_file = fopen(BENCH_SRC, "r");
+  FILE *dst_file = fopen(dst_path, "w");
+
+  if (NULL == src_file || NULL == dst_file) {
+    return EXIT_FAILURE;
+  }
+
+  fputs(prefix, dst_file);
+  int ret = parse_and_emit_file(
+      src_file, BENCH_SRC, dst_file, NULL, NULL, NULL, NULL);
+
+  fclose(src_file);
+  fclose(dst_file);
+  return ret;
+}
+
+static double time_compile(const char *src_path) {
+  double start = now();
+
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    if (EXIT_SUCCESS != compile_c_output(src_path, BENCH_SO, NULL)) {
+      return -1;
+    }
+  }
+
+  return (now() - start) / BENCH_ITERATIONS;
+}
+
+int main() {
+  log_set_level(HTMC_LOG_LEVEL_OFF);
+  log_set_safe();
+
+  if (EXIT_SUCCESS != translate_page(BENCH_C, "") ||
+      EXIT_SUCCESS != translate_page(BENCH_C_STDIO, BENCH_STDIO)) {
+    fprintf(stderr, "unable to translate " BENCH_SRC "\n");
+    return EXIT_FAILURE;
+  }
+
+  double stdio_time = time_compile(BENCH_C_STDIO);
+  double slim_time  = time_compile(BENCH_C);
+
+  if (0 > stdio_time || 0 > slim_time) {
+    fprintf(stderr, "unable to compile " BENCH_SRC "\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("page     with stdio.h: %6.2f ms    slim prologue: %6.2f ms    "
+         "speedup: %.2fx\n",
+         stdio_time * 1e3,
+         slim_time * 1e3,
+         stdio_time / slim_time);
+
+  remove(BENCH_C);
+  remove(BENCH_C_STDIO);
+  remove(BENCH_SO);
+  return EXIT_SUCCESS;
+}
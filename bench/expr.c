@@ -0,0 +1,131 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Compares expression tags (htmc_put) with the equivalent htmc_printf calls
+// Output goes to /dev/null so that only formatting and stdio are measured
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libhtmc/libhtmc-internals.h"
+#include "libhtmc/libhtmc.h"
+
+#define BENCH_ITERATIONS 5000000
+
+static FILE *nullFile;
+
+static int sink_vprintf(htmc_handover_t *handover,
+                        const char      *fmt,
+                        va_list          args) {
+  return vfprintf(nullFile, fmt, args);
+}
+
+static int sink_puts(htmc_handover_t *handover, const char *s) {
+  return fputs(s, nullFile);
+}
+
+static int sink_write(htmc_handover_t *handover, const char *buf, size_t len) {
+  return fwrite(buf, 1, len, nullFile);
+}
+
+static double now() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double printf_time, double put_time) {
+  printf("%-8s htmc_printf: %7.1f ns/op    htmc_put: %7.1f ns/op    "
+         "speedup: %.2fx\n",
+         name,
+         printf_time * 1e9 / BENCH_ITERATIONS,
+         put_time * 1e9 / BENCH_ITERATIONS,
+         printf_time / put_time);
+}
+
+int main() {
+  nullFile = fopen("/dev/null", "w");
+  if (NULL == nullFile) {
+    return EXIT_FAILURE;
+  }
+
+  htmc_handover_t handover = {.variant_id = HTMC_BASE_HANDOVER,
+                              .vprintf    = sink_vprintf,
+                              .puts       = sink_puts,
+                              .write      = sink_write,
+                              .put_int    = impl_base_put_int,
+                              .put_uint   = impl_base_put_uint,
+                              .put_double = impl_base_put_double};
+
+  // Calls below pass the handover in scope, as in pages
+  htmc_handover_t *htmc_handover = &handover;
+
+  double start;
+  double printf_time;
+  double put_time;
+
+  start = now();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    htmc_printf("%d", i - BENCH_ITERATIONS / 2);
+  }
+  printf_time = now() - start;
+
+  start = now();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    htmc_put(i - BENCH_ITERATIONS / 2);
+  }
+  put_time = now() - start;
+  report("int", printf_time, put_time);
+
+  start = now();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    htmc_printf("%g", i / 64.0);
+  }
+  printf_time = now() - start;
+
+  start = now();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    htmc_put(i / 64.0);
+  }
+  put_time = now() - start;
+  report("double", printf_time, put_time);
+
+  const char *str = "htmc";
+
+  start = now();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    htmc_printf("%s", str);
+  }
+  printf_time = now() - start;
+
+  start = now();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    htmc_put(str);
+  }
+  put_time = now() - start;
+  report("string", printf_time, put_time);
+
+  fclose(nullFile);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Measures the freshness check done by every request for a built page
+// Signatures are read from disk, then from directories watched with
+// fscache_watch
+// Must be run from the root of the repository
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "build.h"
+#include "fscache.h"
+#include "log.h"
+
+#define BENCH_ITERATIONS 200000
+#define BENCH_SRC        "examples/index.htmc"
+#define BENCH_TMP        "tmp/bench-fscache"
+
+static double now() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double time_check(const build_paths_t *paths) {
+  double start = now();
+
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    if (EXIT_SUCCESS != build_page(paths)) {
+      return -1;
+    }
+  }
+
+  return (now() - start) / BENCH_ITERATIONS;
+}
+
+int main() {
+  log_set_level(HTMC_LOG_LEVEL_OFF);
+  log_set_safe();
+
+  build_paths_t paths = {0};
+  mkdir(BENCH_TMP, 0755);
+
+  if (!build_paths_init(&paths, BENCH_TMP, BENCH_SRC) ||
+      EXIT_SUCCESS != build_page(&paths)) {
+    fprintf(stderr, "unable to build " BENCH_SRC "\n");
+    return EXIT_FAILURE;
+  }
+
+  double disk_time = time_check(&paths);
+
+  if (!fscache_watch(".")) {
+    fprintf(stderr, "unable to watch the working directory\n");
+    return EXIT_FAILURE;
+  }
+
+  double watched_time = time_check(&paths);
+  fscache_unwatch();
+
+  if (0 > disk_time || 0 > watched_time) {
+    fprintf(stderr, "unable to check " BENCH_SRC "\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("fresh page    from disk: %6.2f us    watched: %6.2f us    "
+         "speedup: %.2fx\n",
+         disk_time * 1e6,
+         watched_time * 1e6,
+         disk_time / watched_time);
+
+  build_paths_free(&paths);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdbool.h>
+
+#define BUILD_SRC_EXT   "htmc"
+#define BUILD_STORE_DIR "store"
+#define BUILD_BUNDLE    "bundle"
+
+// Paths of the artifacts produced for a page
+// These are shared by CGI mode and site builds, so that pages built
+// ahead of time are found by later requests
+typedef struct {
+  const char *src_path;
+  char       *c_file_path;
+  char       *so_file_path;
+  char       *deps_file_path;
+  char       *flags_file_path;
+  char       *obj_file_path;
+  char       *fail_file_path;
+  char       *sum_file_path;
+  char       *lock_file_path;
+  char       *upgrade_file_path;
+  char       *profile_dir;
+  char       *runs_dir;
+  char       *store_dir;
+} build_paths_t;
+
+// Sets the directory of the artifact store
+// Defaults to a directory in tmp_dir
+void build_set_store(const char *store_dir);
+// Enables tiered compilation in build_page
+// Stale pages are built without optimizations and served right away,
+// the optimized build then replaces them in the background
+void build_set_tiered(bool tiered);
+
+bool build_paths_init(build_paths_t *paths,
+                      const char    *tmp_dir,
+                      const char    *src_path);
+void build_paths_free(build_paths_t *paths);
+
+// Returns true if the shared object was built from the current inputs
+// With COMPILE_OPT_PROFILE_USE, new profiling runs make a page stale
+bool build_fresh(const build_paths_t *paths);
+// Returns true if the shared object was built without optimizations
+bool build_pending_upgrade(const build_paths_t *paths);
+int  build_translate(const build_paths_t *paths);
+int  build_compile(const build_paths_t *paths);
+// Builds the page if needed, at most one process builds a page at a time
+// While a page is rebuilt, other processes use the previous version
+int  build_page(const build_paths_t *paths);
+// Saves the counters of a page built for profiling after it was run
+// Runs are merged into the profile of the page when it is built next
+int  build_record_profile(const build_paths_t *paths);
+
+// Builds all stale pages under root_dir using up to jobs processes
+// If bundle_path is not NULL, all pages are also linked into a single
+// shared object with a route table there (see bundle.h)
+int build_site(const char *root_dir,
+               const char *tmp_dir,
+               const char *bundle_path,
+               int         jobs);
+
+// Loads the shared objects of all pages under root_dir that were built,
+// so that the first request to each of them does not pay for loading
+// With warm_up, each page also serves a request whose output is discarded
+// root_dir and tmp_dir stay watched (see fscache_watch), so that later
+// checks of the pages in this process do not read their files from disk
+int build_preload(const char *root_dir, const char *tmp_dir, bool warm_up);
@@ -0,0 +1,42 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "libhtmc/libhtmc-bundle.h"
+
+// Entry points are named after a hash of the page path
+// BUNDLE_SYM_LEN includes the terminator
+#define BUNDLE_SYM_PREFIX "htmc_route_"
+#define BUNDLE_SYM_LEN    (sizeof(BUNDLE_SYM_PREFIX) + 16)
+
+void bundle_entry_sym(const char *path, char sym[BUNDLE_SYM_LEN]);
+
+// Writes the C source of the route table for the given page paths
+// Each page must be compiled with its entry point renamed accordingly
+int bundle_write_table(FILE *dst_file, const char **paths, size_t num_routes);
+
+// Returns the entry point of path, or NULL if it is not in the bundle
+htmc_route_fn_t bundle_find(const htmc_route_table_t *table, const char *path);
@@ -0,0 +1,78 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Sidecar manifests validate build artifacts by content instead of
+// modification time. A manifest records:
+//  * a hash of the htmc version, compiler flags and parser options
+//  * a hash of the contents of all inputs (source and included files)
+//  * the file system signature of each input and of the artifact
+// Inputs are only hashed again when their signature changes, so
+// checking a fresh artifact costs one stat per file and one read
+
+// Returns true if out_path was built from the inputs recorded in the
+// manifest and none of them changed since
+bool cache_fresh(const char *sum_path, const char *out_path);
+
+// Inputs of a build, recorded while the translator reads them so that
+// they are never read again after the build
+typedef struct cache_inputs cache_inputs_t;
+
+cache_inputs_t *cache_inputs_create();
+// Records a file read by the translator, as a parse_input_fcn_t (see
+// parse.h) with a cache_inputs_t as argument
+void            cache_inputs_add(const char *path,
+                                 FILE       *file,
+                                 const char *buf,
+                                 size_t      len,
+                                 void       *arg);
+// Records a file read outside of the translator, before it is read
+void            cache_inputs_add_path(cache_inputs_t *inputs, const char *path);
+// Returns the inputs recorded in the manifest at sum_path, so that
+// artifacts built from the same translation can be recorded without
+// reading them again
+cache_inputs_t *cache_inputs_load(const char *sum_path);
+void            cache_inputs_free(cache_inputs_t *inputs);
+
+// Records that out_path was built from inputs
+// Fails if an input could not be read, as files that do not exist have
+// no signature to compare
+int cache_store(const char           *sum_path,
+                const cache_inputs_t *inputs,
+                const char           *out_path);
+
+// Failed builds are recorded in the same way, along with everything the
+// translator and compiler reported, so that they are not attempted again
+// until one of their inputs changes
+int  cache_store_failure(const char           *fail_path,
+                         const cache_inputs_t *inputs,
+                         const char           *diagnostics,
+                         size_t                diagnostics_len);
+// Returns true if the failure recorded at fail_path still applies
+// If diagnostics is not NULL, it receives a copy of the recorded
+// diagnostics, which must be released by the caller
+bool cache_failed(const char *fail_path, char **diagnostics);
@@ -23,12 +23,18 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct {
   const char *input_file;
   const char *output_path;
   bool        stop_splash;
   bool        log_level_set;
+  int         jobs;
+  bool        shared_runtime;
+  const char *bundle_path;
+  bool        warm_up;
+  size_t      memory_limit;
 } cli_info_t;
 
 typedef int (*cli_fcn_t)(cli_info_t *info, const char *next);
@@ -45,11 +51,22 @@ typedef struct {
 // Support functions
 void print_program_version();
 void print_program_info();
+int  prepare_shared_runtime(cli_info_t info);
 
 // Handler functions (cli_fcn_t)
 int flag_no_splash(cli_info_t *info, const char *next);
 int flag_output(cli_info_t *info, const char *next);
 int flag_log_level(cli_info_t *info, const char *next);
+int flag_specialize_printf(cli_info_t *info, const char *next);
+int flag_minify(cli_info_t *info, const char *next);
+int flag_shared_runtime(cli_info_t *info, const char *next);
+int flag_artifact_store(cli_info_t *info, const char *next);
+int flag_tiered(cli_info_t *info, const char *next);
+int flag_profile(cli_info_t *info, const char *next);
+int flag_bundle(cli_info_t *info, const char *next);
+int flag_warm_up(cli_info_t *info, const char *next);
+int flag_memory_limit(cli_info_t *info, const char *next);
+int flag_jobs(cli_info_t *info, const char *next);
 
 // Setup for executable functions
 int setup_cli_version(cli_info_t *info, const char *next);
@@ -60,6 +77,8 @@ int cli_license(cli_info_t info);
 int cli_version(cli_info_t info);
 int cli_translate(cli_info_t info);
 int cli_compile(cli_info_t info);
+int cli_build(cli_info_t info);
+int cli_preload(cli_info_t info);
 int cli_run(cli_info_t info);
 int cli_load_shared(cli_info_t info);
 int cli_run(cli_info_t info);
@@ -22,4 +22,82 @@
 
 #pragma once
 
-int compile_c_output(const char *src_path, const char *dst_path);
+#include <stddef.h>
+
+typedef enum {
+  // Pages do not carry their own copy of libhtmc, its symbols are
+  // resolved when loading from the host or from a shared libhtmc
+  COMPILE_OPT_SHARED_RUNTIME = 1 << 0,
+  // Pages are built without optimizations, which takes a fraction of
+  // the time. Used to serve a page quickly before its optimized build
+  COMPILE_OPT_FAST = 1 << 1,
+  // Pages count how often their branches are taken, the host writes
+  // the counters after each run (see libhtmc-profile.h)
+  COMPILE_OPT_PROFILE_GENERATE = 1 << 2,
+  // Pages are optimized using the profile in the profile directory
+  COMPILE_OPT_PROFILE_USE = 1 << 3,
+} compile_opt_t;
+
+// Name of profiles in profile directories, without extension
+#define COMPILE_PROFILE_NAME "profile"
+
+// Settings of a single page, any field may be NULL
+typedef struct {
+  // Extra compiler flags separated by spaces, see config.h
+  const char *flags;
+  // Directory of the profile used with COMPILE_OPT_PROFILE_USE
+  const char *profile_dir;
+} compile_page_t;
+
+typedef struct {
+  int    exit_status;
+  char  *diagnostics;
+  size_t diagnostics_len;
+} compile_result_t;
+
+void compile_set_option(compile_opt_t opt);
+void compile_clear_option(compile_opt_t opt);
+int  compile_get_options();
+
+// Compiles a C source file to a shared object in a single compiler run
+// page may be NULL if the page has no settings of its own
+// Everything the compiler prints is collected in result->diagnostics
+// The result must be released with compile_result_free in any case
+int  compile_c_output_r(const char           *src_path,
+                        const char           *dst_path,
+                        const compile_page_t *page,
+                        compile_result_t     *result);
+void compile_result_free(compile_result_t *result);
+
+// Same as compile_c_output_r, but diagnostics are written to stderr
+int compile_c_output(const char           *src_path,
+                     const char           *dst_path,
+                     const compile_page_t *page);
+
+// Compiles a page to an object to be linked into a bundle
+// The entry point of the page is renamed to entry_sym and all other
+// symbols it defines are made local, so that pages cannot clash
+int compile_c_object(const char           *src_path,
+                     const char           *dst_path,
+                     const compile_page_t *page,
+                     const char           *entry_sym);
+// Links a route table and the objects listed in objs_path (a compiler
+// response file) into a single shared object
+// Libraries and other link flags are taken from page
+int compile_c_bundle(const char           *table_path,
+                     const char           *objs_path,
+                     const char           *dst_path,
+                     const compile_page_t *page);
+
+// Adds the counters of a profiling run to the profile in profile_dir
+// Both directories contain a profile named COMPILE_PROFILE_NAME
+int compile_merge_profile(const char *profile_dir, const char *run_dir);
+
+// Describes the compiler, its version and target, and the flags used by
+// compile_c_output
+// Shared objects built with a different signature must be rebuilt
+// The optimization level is not part of the signature, pages built at
+// any level are valid builds of the same inputs
+const char *compile_signature();
+// Returns the optimization flag used by compile_c_output
+const char *compile_level();
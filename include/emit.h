@@ -22,14 +22,31 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
+// All static markup of a page is collected in a single blob
+// Code emitted for HTML blocks references it by offset and length
+typedef struct {
+  char  *buf;
+  size_t len;
+  size_t cap;
+  bool   failed;
+} emit_blob_t;
+
 void emit_str(FILE *dst_file, const char *str);
 void emit_base(FILE *dst_file);
 void emit_end(FILE *dst_file);
-void emit_html_base(FILE *dst_file);
-void emit_html_end(FILE *dst_file);
-void emit_html_block(FILE *dst_file);
-void emit_html_block_end(FILE *dst_file);
+void emit_expr_base(FILE *dst_file);
+void emit_expr_end(FILE *dst_file);
+void emit_html_segment(FILE *dst_file, size_t offset, size_t len);
+void emit_html_blob(FILE *dst_file, const emit_blob_t *blob);
 void emit_char(FILE *dst_file, char chr);
 void emit_char_escaped(FILE *dst_file, char chr);
+void emit_buf(FILE *dst_file, const char *buf, size_t len);
+void emit_html_run(FILE *dst_file, const char *run, size_t len);
+
+bool emit_blob_append(emit_blob_t *blob, const char *buf, size_t len);
+bool emit_blob_append_char(emit_blob_t *blob, char chr);
+void emit_blob_free(emit_blob_t *blob);
@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 // These functions compare the "last modified" value of two files
@@ -35,3 +37,29 @@
 double fscache_cmp_ff(FILE *f1, FILE *f2);
 double fscache_cmp_pp(const char *p1, const char *p2);
 double fscache_cmp_fp(FILE *f1, const char *f2);
+
+// Identity of a file's current contents as seen by the file system
+// Any write, rename or copy over the file changes at least one field,
+// so two equal signatures mean the file was not touched in between
+typedef struct {
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  uint64_t mtime_ns;
+  uint64_t ctime_ns;
+} fscache_sig_t;
+
+// Returns false if the file does not exist or its signature is unknown
+bool fscache_sig_p(const char *path, fscache_sig_t *sig);
+bool fscache_sig_f(FILE *file, fscache_sig_t *sig);
+bool fscache_sig_eq(const fscache_sig_t *s1, const fscache_sig_t *s2);
+
+// Keeps the signatures of files in dir_path and in the directories below
+// it in memory, so that fscache_sig_p does not read them from disk again
+// until inotify reports a change. Files outside watched directories, and
+// all files on systems without inotify, are still read from disk
+// Returns false if the directory could not be watched completely
+// Changes made through hard links in other directories are not seen
+bool fscache_watch(const char *dir_path);
+// Stops watching all directories and forgets all signatures
+void fscache_unwatch();
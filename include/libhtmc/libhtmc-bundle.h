@@ -0,0 +1,50 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Included in the route table of site bundles, see bundle.h
+// A bundle contains all pages of a site, each one under its own entry
+// point. Routes are laid out as a perfect hash table built by htmc, the
+// host finds the entry point of a path with a single probe
+
+#include <stdint.h>
+
+#include "libhtmc.h"
+
+#define HTMC_BUNDLE_ROUTES_SYM "htmc_routes"
+
+typedef void (*htmc_route_fn_t)(htmc_handover_t *handover);
+
+typedef struct {
+  const char     *path;
+  htmc_route_fn_t entry;
+} htmc_route_t;
+
+// Keys are hashed into num_slots buckets, the displacement of a bucket
+// either is the slot of its only route (-slot - 1) or the seed that
+// hashes its routes to their slots. Empty slots have a NULL path
+typedef struct {
+  uint32_t            num_slots;
+  const int32_t      *displacements;
+  const htmc_route_t *routes;
+} htmc_route_table_t;
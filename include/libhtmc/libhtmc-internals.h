@@ -27,12 +27,46 @@
 
 #include "libhtmc/libhtmc.h"
 
-int   impl_debug_vprintf(htmc_handover_t *handover,
+int impl_debug_vprintf(htmc_handover_t *handover,
+                       const char      *fmt,
+                       va_list          args);
+int impl_debug_puts(htmc_handover_t *handover, const char *s);
+int impl_debug_write(htmc_handover_t *handover, const char *buf, size_t len);
+
+int impl_discard_vprintf(htmc_handover_t *handover,
                          const char      *fmt,
                          va_list          args);
-int   impl_debug_puts(htmc_handover_t *handover, const char *s);
-void *impl_debug_alloc(htmc_handover_t *handover, size_t nbytes);
-void  impl_debug_free(htmc_handover_t *handover, void *ptr);
+int impl_discard_puts(htmc_handover_t *handover, const char *s);
+int impl_discard_write(htmc_handover_t *handover, const char *buf, size_t len);
+
+// Arena behind htmc_alloc, one per process
+// Memory is taken from chunks that grow with the request and is released
+// all at once by htmc_arena_reset between requests, which keeps the
+// chunks for the next one. With a cap other than 0, allocations that
+// would bring the memory in use above it fail
+typedef struct htmc_arena htmc_arena_t;
+
+typedef struct {
+  size_t cap;
+  size_t used;
+  // Most memory in use at once since the arena was created
+  size_t high_water;
+  // Memory held in chunks
+  size_t reserved;
+} htmc_arena_stats_t;
+
+htmc_arena_t      *htmc_arena_create(size_t cap);
+void              *htmc_arena_alloc(htmc_arena_t *arena, size_t nbytes);
+void               htmc_arena_reset(htmc_arena_t *arena);
+htmc_arena_stats_t htmc_arena_stats(const htmc_arena_t *arena);
+void               htmc_arena_destroy(htmc_arena_t *arena);
+
+void *impl_arena_alloc(htmc_handover_t *handover, size_t nbytes);
+void  impl_arena_free(htmc_handover_t *handover, void *ptr);
+
+int impl_base_put_int(htmc_handover_t *handover, long long value);
+int impl_base_put_uint(htmc_handover_t *handover, unsigned long long value);
+int impl_base_put_double(htmc_handover_t *handover, double value);
 
 int impl_base_query_vscanf(htmc_handover_t *handover,
                            const char      *fmt,
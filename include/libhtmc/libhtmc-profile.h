@@ -0,0 +1,95 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Included in pages built for profiling, see COMPILE_OPT_PROFILE_GENERATE
+// libgcov writes profiles at exit through the C library, which pages do
+// not link. Pages built for profiling instead keep their counters in a
+// section and the host writes them with htmc_profile_dump after a run
+// Definitions are only compiled into pages, the host uses the types
+
+#include <stddef.h>
+
+#define HTMC_PROFILE_DUMP_SYM "htmc_profile_dump"
+
+struct gcov_info;
+
+typedef void (*htmc_profile_write_t)(const void *data,
+                                     unsigned    len,
+                                     void       *arg);
+typedef void *(*htmc_profile_alloc_t)(unsigned len, void *arg);
+typedef void (*htmc_profile_dump_t)(htmc_profile_write_t write,
+                                    htmc_profile_alloc_t alloc,
+                                    void                *arg);
+
+#ifdef HTMC_PROFILE_GENERATE
+#define HTMC_PROFILE_HIDDEN \
+  __attribute__((visibility("hidden"), no_profile_instrument_function))
+
+extern void __gcov_info_to_gcda(const struct gcov_info *info,
+                                void (*filename)(const char *name, void *arg),
+                                htmc_profile_write_t write,
+                                htmc_profile_alloc_t alloc,
+                                void                *arg);
+
+// Bounds of the section named by -fprofile-info-section
+extern const struct gcov_info *const __start_htmc_profile[]
+    __attribute__((weak, visibility("hidden")));
+extern const struct gcov_info *const __stop_htmc_profile[]
+    __attribute__((weak, visibility("hidden")));
+
+// Profiles are merged by gcov-tool on the host, never by the page
+HTMC_PROFILE_HIDDEN void __gcov_merge_add(void *counters, unsigned n) {
+}
+
+// Referenced by __gcov_info_to_gcda for value profiles, which are not
+// collected (see compile.c)
+HTMC_PROFILE_HIDDEN void abort(void) {
+  __builtin_trap();
+}
+
+HTMC_PROFILE_HIDDEN void *mmap(void *addr,
+                               size_t len,
+                               int    prot,
+                               int    flags,
+                               int    fd,
+                               long   offset) {
+  return (void *)-1;
+}
+
+__attribute__((no_profile_instrument_function)) static void
+htmc_profile_filename(const char *name, void *arg) {
+  // The host decides where profiles are written
+}
+
+__attribute__((no_profile_instrument_function)) void
+htmc_profile_dump(htmc_profile_write_t write,
+                  htmc_profile_alloc_t alloc,
+                  void                *arg) {
+  for (const struct gcov_info *const *info = __start_htmc_profile;
+       info < __stop_htmc_profile;
+       info++) {
+    __gcov_info_to_gcda(*info, htmc_profile_filename, write, alloc, arg);
+  }
+}
+#endif
@@ -23,7 +23,24 @@
 #pragma once
 #include <stdarg.h>
 #include <stdbool.h>
-#include <stdio.h>
+#include <stddef.h>
+
+// Selects the writer of htmc_put based on the type of x. Character constants
+// are ints in C, so <?= 'c' ?> prints 99: cast them, as in <?= (char)'c' ?>
+#define htmc_put_writer(x)                \
+  _Generic((x),                           \
+      char *: htmc_put_str,               \
+      const char *: htmc_put_str,         \
+      char: htmc_put_char,                \
+      float: htmc_put_double,             \
+      double: htmc_put_double,            \
+      long double: htmc_put_double,       \
+      unsigned char: htmc_put_uint,       \
+      unsigned short: htmc_put_uint,      \
+      unsigned int: htmc_put_uint,        \
+      unsigned long: htmc_put_uint,       \
+      unsigned long long: htmc_put_uint,  \
+      default: htmc_put_int)
 
 typedef enum htmc_handover_variant {
   HTMC_BASE_HANDOVER
@@ -44,17 +61,71 @@ typedef struct htmc_handover {
   size_t      content_length;
   const char *content_type;
   const char *request_body;
+
+  // Fields are only ever added here, so that pages built against an
+  // older header find the ones they know at the same offsets
+  int (*write)(htmc_handover_t *handover, const char *buf, size_t len);
+  int (*put_int)(htmc_handover_t *handover, long long value);
+  int (*put_uint)(htmc_handover_t *handover, unsigned long long value);
+  int (*put_double)(htmc_handover_t *handover, double value);
+
+  // Memory handed out by alloc, owned by the host (see
+  // libhtmc-internals.h)
+  struct htmc_arena *arena;
 } htmc_handover_t;
 
-void  htmc_bind(htmc_handover_t *handover);
-int   htmc_printf(const char *fmt, ...);
-int   htmc_vprintf(const char *fmt, va_list args);
-int   htmc_puts(const char *s);
-int   htmc_query_scanf(const char *fmt, ...);
-int   htmc_query_vscanf(const char *fmt, va_list args);
-int   htmc_form_scanf(const char *fmt, ...);
-int   htmc_form_vscafn(const char *fmt, va_list args);
-void *htmc_alloc(size_t nbytes);
-void  htmc_free(void *ptr);
-void  htmc_error(const char *fmt, ...);
-void  htmc_verror(const char *fmt, va_list args);
+// The handover of the request is passed to every function, so that a
+// loaded page can serve concurrent requests from different threads
+int   htmc_printf(htmc_handover_t *handover, const char *fmt, ...);
+int   htmc_vprintf(htmc_handover_t *handover, const char *fmt, va_list args);
+int   htmc_puts(htmc_handover_t *handover, const char *s);
+int   htmc_write(htmc_handover_t *handover, const char *buf, size_t len);
+int   htmc_put_int(htmc_handover_t *handover, long long value);
+int   htmc_put_uint(htmc_handover_t *handover, unsigned long long value);
+int   htmc_put_double(htmc_handover_t *handover, double value);
+int   htmc_put_char(htmc_handover_t *handover, char value);
+int   htmc_put_str(htmc_handover_t *handover, const char *value);
+int   htmc_put_strn(htmc_handover_t *handover, const char *value, size_t len);
+int   htmc_query_scanf(htmc_handover_t *handover, const char *fmt, ...);
+int   htmc_query_vscanf(htmc_handover_t *handover,
+                        const char      *fmt,
+                        va_list          args);
+int   htmc_form_scanf(htmc_handover_t *handover, const char *fmt, ...);
+int   htmc_form_vscafn(htmc_handover_t *handover,
+                       const char      *fmt,
+                       va_list          args);
+void *htmc_alloc(htmc_handover_t *handover, size_t nbytes);
+void  htmc_free(htmc_handover_t *handover, void *ptr);
+void  htmc_error(htmc_handover_t *handover, const char *fmt, ...);
+void  htmc_verror(htmc_handover_t *handover, const char *fmt, va_list args);
+
+// Pages do not pass the handover themselves: htmc_main receives it as
+// htmc_handover, and these macros pass it to the functions of the same
+// name. Hosts that call the functions directly must define
+// HTMC_EXPLICIT_HANDOVER before including this header
+#ifndef HTMC_EXPLICIT_HANDOVER
+#define htmc_printf(...)             htmc_printf(htmc_handover, __VA_ARGS__)
+#define htmc_vprintf(fmt, args)      htmc_vprintf(htmc_handover, fmt, args)
+#define htmc_puts(s)                 htmc_puts(htmc_handover, s)
+#define htmc_write(buf, len)         htmc_write(htmc_handover, buf, len)
+#define htmc_put_int(value)          htmc_put_int(htmc_handover, value)
+#define htmc_put_uint(value)         htmc_put_uint(htmc_handover, value)
+#define htmc_put_double(value)       htmc_put_double(htmc_handover, value)
+#define htmc_put_char(value)         htmc_put_char(htmc_handover, value)
+#define htmc_put_str(value)          htmc_put_str(htmc_handover, value)
+#define htmc_put_strn(value, len)    htmc_put_strn(htmc_handover, value, len)
+#define htmc_query_scanf(...) \
+  htmc_query_scanf(htmc_handover, __VA_ARGS__)
+#define htmc_query_vscanf(fmt, args) htmc_query_vscanf(htmc_handover, fmt, args)
+#define htmc_form_scanf(...)         htmc_form_scanf(htmc_handover, __VA_ARGS__)
+#define htmc_form_vscafn(fmt, args)  htmc_form_vscafn(htmc_handover, fmt, args)
+#define htmc_alloc(nbytes)           htmc_alloc(htmc_handover, nbytes)
+#define htmc_free(ptr)               htmc_free(htmc_handover, ptr)
+#define htmc_error(...)              htmc_error(htmc_handover, __VA_ARGS__)
+#define htmc_verror(fmt, args)       htmc_verror(htmc_handover, fmt, args)
+
+// Writes the value of an expression without parsing a format string
+#define htmc_put(x) htmc_put_writer(x)(htmc_handover, x)
+// Writes a string literal whose length is known at compile time
+#define htmc_write_literal(s) htmc_write(s, sizeof(s) - 1)
+#endif
@@ -24,13 +24,52 @@
 
 #include <stdbool.h>
 
+#include "libhtmc/libhtmc-bundle.h"
+#include "libhtmc/libhtmc-internals.h"
 #include "libhtmc/libhtmc.h"
 
 #define HTMC_ENTRY_POINT_SYM "htmc_main"
+#define HTMC_RUNTIME_PATH    "./bin/libhtmc.so"
 
-typedef int (*htmc_entry_point_t)(htmc_handover_t *);
+typedef void (*htmc_entry_point_t)(htmc_handover_t *);
 
+// Makes libhtmc symbols available to pages built for the shared runtime
+// Must be called before loading such pages
+void              *load_htmc_runtime(const char *runtime_path);
 void              *load_htmc_so(const char *so_file_path);
 htmc_entry_point_t get_htmc_entry_point(void *so_handle);
 int call_htmc_entry(htmc_entry_point_t entry_point, htmc_handover_t *handover);
 int run_htmc_so(const char *so_file_path, htmc_handover_t *handover);
+
+// Pages stay loaded between requests in a registry, one version per path
+// A page is loaded again when its shared object is replaced, requests
+// holding the previous version finish on it, and it is unloaded once
+// they have all released it
+typedef struct load_page load_page_t;
+
+// Returns the current version of the page, or NULL if it cannot be
+// loaded. The page must be released with load_page_release
+load_page_t       *load_page_acquire(const char *so_file_path);
+// Same as load_page_acquire, but all symbols of the page are bound
+// right away instead of when they are first used
+load_page_t       *load_page_preload(const char *so_file_path);
+htmc_entry_point_t load_page_entry(const load_page_t *page);
+// Runs a GET request without a query through the page and discards the
+// response, so that the code and data it uses are paged in. The page
+// allocates from arena, which is reset once the request is done
+int                load_page_warm_up(load_page_t *page, htmc_arena_t *arena);
+void               load_page_release(load_page_t *page);
+// Removes all pages from the registry, pages still in use are unloaded
+// when released
+void               load_registry_clear();
+
+// Looks up the entry point of a page in a bundle (see bundle.h)
+// Running a path without a route fails
+htmc_route_fn_t    get_htmc_route(void *bundle_handle, const char *path);
+int                run_htmc_route(const char      *bundle_path,
+                                  const char      *path,
+                                  htmc_handover_t *handover);
+
+// Writes the counters of a page built for profiling to profile_path
+// The page must have been run by this process
+int dump_htmc_profile(const char *so_file_path, const char *profile_path);
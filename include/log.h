@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <stdio.h>
+
 typedef enum {
   HTMC_LOG_LEVEL_ALL,
   HTMC_LOG_LEVEL_INFO,
@@ -35,4 +37,6 @@ void log_error(const char *message);
 void log_info(const char *message);
 void log_set_level(log_lvl_t lvl);
 void log_set_safe();
+// Errors are also written to capture_file until it is set to NULL
+void log_set_capture(FILE *capture_file);
 int  log_translate_level(const char *lvl_str);
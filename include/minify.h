@@ -0,0 +1,50 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MINIFY_MAX_TAG 16
+
+typedef enum {
+  MINIFY_TEXT,
+  MINIFY_TAG,
+  MINIFY_COMMENT,
+  MINIFY_RAW,
+} minify_mode_t;
+
+// Static runs of a page are split by code blocks, so the position in
+// the markup is carried from one run to the next
+typedef struct {
+  minify_mode_t mode;
+  char          quote;
+  bool          opens_raw;
+  char          tag[MINIFY_MAX_TAG + 1];
+} minify_state_t;
+
+// Minifies a static run in place and returns its new length
+// Whitespace sequences are collapsed to a single character and comments
+// are removed, except inside tags and <pre>, <textarea>, <script> and
+// <style> elements. Comments split by a code block are kept
+size_t minify_run(minify_state_t *state, char *run, size_t len);
@@ -22,6 +22,40 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdio.h>
 
-int parse_and_emit(FILE *src_file, FILE *dst_file);
+#define PARSE_MAX_PROFILE 64
+
+typedef enum {
+  PARSE_OPT_SPECIALIZE_PRINTF = 1 << 0,
+  PARSE_OPT_MINIFY            = 1 << 1,
+} parse_opt_t;
+
+// Called with every file before it is translated, and with a NULL file
+// for included files that cannot be opened. buf holds the contents that
+// are translated, or is NULL if the file is read as a stream, in which
+// case the file must be left at its start
+typedef void (*parse_input_fcn_t)(const char *path,
+                                  FILE       *file,
+                                  const char *buf,
+                                  size_t      len,
+                                  void       *arg);
+
+void parse_set_option(parse_opt_t opt);
+int  parse_get_options();
+int  parse_and_emit(FILE *src_file, FILE *dst_file);
+// Translates src_file resolving includes relative to src_path
+// Paths of included files are written to deps_file, one per line
+// The compiler profile selected by a profile tag is copied to profile
+// (PARSE_MAX_PROFILE bytes), which is left empty if there is none
+// If input_fcn is not NULL, it is called with input_arg for every file
+int  parse_and_emit_file(FILE             *src_file,
+                         const char       *src_path,
+                         FILE             *dst_file,
+                         FILE             *deps_file,
+                         char             *profile,
+                         parse_input_fcn_t input_fcn,
+                         void             *input_arg);
+int  parse_and_emit_stream(FILE *src_file, FILE *dst_file);
+int  parse_and_emit_buffer(const char *src, size_t len, FILE *dst_file);
@@ -0,0 +1,47 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "compile.h"
+
+// Compiled pages are kept in a content-addressed store
+// Entries are named after a hash of the generated C code, the compiler
+// signature and optimization level and the htmc version, so pages that
+// translate to the same code share one entry. The store is a plain
+// directory and may be shared by several processes, hosts and containers
+
+// Returns the path of the store entry for a translated page
+// The flags and profile used to build the page are part of the key
+// Returns NULL if the translated page cannot be read
+char *store_entry_path(const char           *store_dir,
+                       const char           *c_file_path,
+                       const compile_page_t *page);
+bool  store_has(const char *entry_path);
+
+// Publishes a compiled page, the entry is replaced atomically
+int store_put(const char *tmp_path, const char *entry_path);
+
+// Places a store entry at dst_path, as a hard link if possible
+int store_install(const char *entry_path, const char *dst_path);
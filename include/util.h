@@ -23,3 +23,8 @@
 #pragma once
 
 void safe_free(void *ptr);
+
+// Returns a path next to path that no other process writes to
+// Files are written there and then renamed over path, so that readers
+// never see them half-written
+char *tmp_path_for(const char *path);
@@ -0,0 +1,1290 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "build.h"
+#include "bundle.h"
+#include "cache.h"
+#include "compile.h"
+#include "config.h"
+#include "deps.h"
+#include "fscache.h"
+#include "fslock.h"
+#include "libhtmc/libhtmc-internals.h"
+#include "load.h"
+#include "log.h"
+#include "parse.h"
+#include "store.h"
+#include "util.h"
+
+#define MANGLE_MAX_LEN 3
+#define FLAGS_MAX_LEN  4096
+
+typedef struct {
+  char **paths;
+  size_t len;
+  size_t cap;
+} build_list_t;
+
+// Pages are only recorded as failed if their inputs were rejected, other
+// errors (such as running out of disk space) may not happen again
+typedef struct {
+  FILE  *file;
+  char  *buf;
+  size_t len;
+  bool   rejected;
+} build_diag_t;
+
+// Section
+// Single pages
+
+const char *buildStoreDir = NULL;
+bool        buildTiered   = false;
+
+static char *artifact_path(const char *tmp_dir,
+                           const char *fn_templ,
+                           const char *ext) {
+  char *path = malloc(strlen(tmp_dir) + 1 + strlen(fn_templ) + strlen(ext) + 1);
+
+  if (NULL != path) {
+    sprintf(path, "%s/%s%s", tmp_dir, fn_templ, ext);
+  }
+
+  return path;
+}
+
+// Artifacts of all pages share a directory, so paths are flattened
+// Separators and the escape character itself are percent-encoded, so
+// that different paths never map to the same artifacts
+static char *mangle_path(const char *src_path) {
+  char *mangled = malloc(strlen(src_path) * MANGLE_MAX_LEN + 1);
+  char *out     = mangled;
+
+  if (NULL == mangled) {
+    return NULL;
+  }
+
+  for (const char *c = src_path; *c; c++) {
+    switch (*c) {
+    case '/':
+      out = stpcpy(out, "%2F");
+      break;
+    case '\\':
+      out = stpcpy(out, "%5C");
+      break;
+    case '%':
+      out = stpcpy(out, "%25");
+      break;
+    default:
+      *out++ = *c;
+    }
+  }
+
+  *out = 0;
+  return mangled;
+}
+
+void build_set_store(const char *store_dir) {
+  buildStoreDir = store_dir;
+}
+
+void build_set_tiered(bool tiered) {
+  buildTiered = tiered;
+}
+
+bool build_paths_init(build_paths_t *paths,
+                      const char    *tmp_dir,
+                      const char    *src_path) {
+  char *fn_templ = mangle_path(src_path);
+  *paths         = (build_paths_t){.src_path = src_path};
+
+  if (NULL == fn_templ) {
+    log_fatal("out of memory");
+    return false;
+  }
+
+  paths->c_file_path       = artifact_path(tmp_dir, fn_templ, ".c");
+  paths->so_file_path      = artifact_path(tmp_dir, fn_templ, ".so");
+  paths->deps_file_path    = artifact_path(tmp_dir, fn_templ, ".deps");
+  paths->flags_file_path   = artifact_path(tmp_dir, fn_templ, ".cflags");
+  paths->obj_file_path     = artifact_path(tmp_dir, fn_templ, ".o");
+  paths->fail_file_path    = artifact_path(tmp_dir, fn_templ, ".fail");
+  paths->sum_file_path     = artifact_path(tmp_dir, fn_templ, ".sum");
+  paths->lock_file_path    = artifact_path(tmp_dir, fn_templ, ".lock");
+  paths->upgrade_file_path = artifact_path(tmp_dir, fn_templ, ".upgrade");
+  paths->profile_dir       = artifact_path(tmp_dir, fn_templ, ".prof");
+  paths->runs_dir          = artifact_path(tmp_dir, fn_templ, ".runs");
+  paths->store_dir         = (NULL != buildStoreDir)
+                                 ? strdup(buildStoreDir)
+                                 : artifact_path(tmp_dir, BUILD_STORE_DIR, "");
+  safe_free(fn_templ);
+
+  if (NULL == paths->c_file_path || NULL == paths->so_file_path ||
+      NULL == paths->deps_file_path || NULL == paths->flags_file_path ||
+      NULL == paths->obj_file_path || NULL == paths->fail_file_path ||
+      NULL == paths->sum_file_path || NULL == paths->lock_file_path ||
+      NULL == paths->upgrade_file_path || NULL == paths->profile_dir ||
+      NULL == paths->runs_dir || NULL == paths->store_dir) {
+    log_fatal("out of memory");
+    build_paths_free(paths);
+    return false;
+  }
+
+  return true;
+}
+
+void build_paths_free(build_paths_t *paths) {
+  safe_free(paths->c_file_path);
+  safe_free(paths->so_file_path);
+  safe_free(paths->deps_file_path);
+  safe_free(paths->flags_file_path);
+  safe_free(paths->obj_file_path);
+  safe_free(paths->fail_file_path);
+  safe_free(paths->sum_file_path);
+  safe_free(paths->lock_file_path);
+  safe_free(paths->upgrade_file_path);
+  safe_free(paths->profile_dir);
+  safe_free(paths->runs_dir);
+  safe_free(paths->store_dir);
+  *paths = (build_paths_t){0};
+}
+
+// The page is built again if its source, any of the files it includes,
+// the htmc version or the compiler flags changed
+bool build_fresh(const build_paths_t *paths) {
+  if ((compile_get_options() & COMPILE_OPT_PROFILE_USE) &&
+      0 == access(paths->runs_dir, F_OK)) {
+    return false;
+  }
+
+  return cache_fresh(paths->sum_file_path, paths->so_file_path);
+}
+
+// Pages built without optimizations are marked until the optimized
+// build replaces them, so that an interrupted upgrade is started again
+bool build_pending_upgrade(const build_paths_t *paths) {
+  return 0 == access(paths->upgrade_file_path, F_OK);
+}
+
+static bool mark_upgrade(const build_paths_t *paths) {
+  if (!(compile_get_options() & COMPILE_OPT_FAST)) {
+    return true;
+  }
+
+  FILE *upgrade_file = fopen(paths->upgrade_file_path, "w");
+  return NULL != upgrade_file && 0 == fclose(upgrade_file);
+}
+
+// Artifacts are written to a temporary file first and renamed in place
+// once complete, readers see either the old or the new version
+static FILE *open_tmp(const char *path, char **tmp_path) {
+  *tmp_path = tmp_path_for(path);
+  return (NULL != *tmp_path) ? fopen(*tmp_path, "w") : NULL;
+}
+
+static bool commit_tmp(FILE *file, char *tmp_path, const char *path, bool ok) {
+  if (NULL != file) {
+    ok = 0 == fclose(file) && ok;
+  }
+
+  ok = ok && NULL != file && 0 == rename(tmp_path, path);
+  if (!ok && NULL != tmp_path) {
+    remove(tmp_path);
+  }
+
+  safe_free(tmp_path);
+  return ok;
+}
+
+// Errors reported while building a page are kept, so that requests
+// for the page can fail right away until its inputs change
+static void capture_diagnostics(build_diag_t *diag) {
+  *diag      = (build_diag_t){0};
+  diag->file = open_memstream(&diag->buf, &diag->len);
+  log_set_capture(diag->file);
+}
+
+// A failed translation records the files it read before the error
+static void record_outcome(const build_paths_t  *paths,
+                           build_diag_t         *diag,
+                           const cache_inputs_t *inputs) {
+  log_set_capture(NULL);
+  if (NULL != diag->file) {
+    fclose(diag->file);
+  }
+
+  if (diag->rejected && NULL != diag->buf) {
+    cache_store_failure(paths->fail_file_path, inputs, diag->buf, diag->len);
+  }
+
+  safe_free(diag->buf);
+}
+
+// Returns true if the page failed to build from its current inputs
+static bool build_failed(const build_paths_t *paths) {
+  char *diagnostics = NULL;
+  if (!cache_failed(paths->fail_file_path, &diagnostics)) {
+    return false;
+  }
+
+  log_error("page did not change since it failed to build");
+  if (NULL != diagnostics) {
+    fputs(diagnostics, stderr);
+  }
+
+  safe_free(diagnostics);
+  return true;
+}
+
+// The compiler flags of a page are the default profile followed by the
+// profile it selects, so that the page can override the site defaults
+static int write_page_flags(FILE           *flags_file,
+                            FILE           *deps_file,
+                            cache_inputs_t *inputs,
+                            const char     *profile) {
+  if (0 != access(CONFIG_PATH, F_OK)) {
+    if (0 != *profile) {
+      log_fatal("unknown compiler profile");
+      return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+  }
+
+  // Changes to the configuration rebuild the pages that use it
+  fprintf(deps_file, "%s\n", CONFIG_PATH);
+  cache_inputs_add_path(inputs, CONFIG_PATH);
+
+  char *default_flags =
+      config_profile_flags(CONFIG_PATH, CONFIG_DEFAULT_PROFILE);
+  char *page_flags = NULL;
+
+  if (0 != *profile &&
+      NULL == (page_flags = config_profile_flags(CONFIG_PATH, profile))) {
+    log_fatal("unknown compiler profile");
+    safe_free(default_flags);
+    return EXIT_FAILURE;
+  }
+
+  fprintf(flags_file,
+          "%s %s\n",
+          (NULL != default_flags) ? default_flags : "",
+          (NULL != page_flags) ? page_flags : "");
+
+  safe_free(default_flags);
+  safe_free(page_flags);
+  return EXIT_SUCCESS;
+}
+
+int build_translate(const build_paths_t *paths) {
+  FILE *src_file = fopen(paths->src_path, "r");
+
+  if (NULL == src_file) {
+    log_fatal("no such file or directory");
+    return EXIT_FAILURE;
+  }
+
+  char *c_tmp_path;
+  char *deps_tmp_path;
+  char *flags_tmp_path;
+  FILE *c_file     = open_tmp(paths->c_file_path, &c_tmp_path);
+  FILE *deps_file  = open_tmp(paths->deps_file_path, &deps_tmp_path);
+  FILE *flags_file = open_tmp(paths->flags_file_path, &flags_tmp_path);
+
+  // Inputs are recorded as they are translated, the manifest written
+  // after compiling does not read them again
+  cache_inputs_t *inputs = cache_inputs_create();
+
+  if (NULL == c_file || NULL == deps_file || NULL == flags_file ||
+      NULL == inputs) {
+    log_fatal("unable to create output file");
+    fclose(src_file);
+    cache_inputs_free(inputs);
+    commit_tmp(c_file, c_tmp_path, paths->c_file_path, false);
+    commit_tmp(deps_file, deps_tmp_path, paths->deps_file_path, false);
+    commit_tmp(flags_file, flags_tmp_path, paths->flags_file_path, false);
+    return EXIT_FAILURE;
+  }
+
+  build_diag_t diag;
+  char         profile[PARSE_MAX_PROFILE];
+
+  capture_diagnostics(&diag);
+  int ret = parse_and_emit_file(src_file,
+                                paths->src_path,
+                                c_file,
+                                deps_file,
+                                profile,
+                                cache_inputs_add,
+                                inputs);
+  fclose(src_file);
+
+  if (EXIT_SUCCESS != ret) {
+    log_fatal("error while parsing source file");
+  } else {
+    ret = write_page_flags(flags_file, deps_file, inputs, profile);
+  }
+
+  diag.rejected = EXIT_SUCCESS != ret;
+  record_outcome(paths, &diag, inputs);
+
+  bool ok = EXIT_SUCCESS == ret;
+  ok = commit_tmp(flags_file, flags_tmp_path, paths->flags_file_path, ok);
+  ok = commit_tmp(deps_file, deps_tmp_path, paths->deps_file_path, ok);
+  ok = commit_tmp(c_file, c_tmp_path, paths->c_file_path, ok);
+
+  // The translation stands for the page until it is compiled, this is
+  // also the final manifest of partials
+  ok = ok && EXIT_SUCCESS == cache_store(paths->sum_file_path,
+                                         inputs,
+                                         paths->c_file_path);
+  cache_inputs_free(inputs);
+
+  if (EXIT_SUCCESS != ret) {
+    return EXIT_FAILURE;
+  }
+
+  if (!ok) {
+    log_fatal("unable to create output file");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+static int compile_to_store(const build_paths_t  *paths,
+                            const compile_page_t *page,
+                            const char           *entry_path,
+                            build_diag_t         *diag) {
+  char *so_tmp_path = tmp_path_for(entry_path);
+  if (NULL == so_tmp_path) {
+    return EXIT_FAILURE;
+  }
+
+  compile_result_t result;
+  int ret = compile_c_output_r(paths->c_file_path, so_tmp_path, page, &result);
+
+  if (NULL != result.diagnostics) {
+    fwrite(result.diagnostics, 1, result.diagnostics_len, stderr);
+  }
+
+  if (NULL != result.diagnostics && NULL != diag->file) {
+    fwrite(result.diagnostics, 1, result.diagnostics_len, diag->file);
+  }
+
+  // The compiler ran and rejected the page
+  diag->rejected = 0 < result.exit_status;
+  compile_result_free(&result);
+  if (EXIT_SUCCESS != ret) {
+    remove(so_tmp_path);
+    safe_free(so_tmp_path);
+    return EXIT_FAILURE;
+  }
+
+  ret = store_put(so_tmp_path, entry_path);
+  safe_free(so_tmp_path);
+  return ret;
+}
+
+// Pages translated before profiles existed have no flags
+static const char *read_page_flags(const build_paths_t *paths,
+                                   char                 flags[FLAGS_MAX_LEN]) {
+  FILE *flags_file = fopen(paths->flags_file_path, "r");
+  flags[0]         = 0;
+
+  if (NULL != flags_file) {
+    if (NULL == fgets(flags, FLAGS_MAX_LEN, flags_file)) {
+      flags[0] = 0;
+    }
+
+    fclose(flags_file);
+    flags[strcspn(flags, "\n")] = 0;
+  }
+
+  return flags;
+}
+
+// Runs are merged into the profile and removed, runs that cannot be
+// merged are dropped so that they do not make the page stale forever
+static void merge_profiles(const build_paths_t *paths) {
+  DIR *dir = opendir(paths->runs_dir);
+  if (NULL == dir) {
+    return;
+  }
+
+  struct dirent *entry;
+  while (NULL != (entry = readdir(dir))) {
+    if ('.' == entry->d_name[0]) {
+      continue;
+    }
+
+    char *run_dir  = artifact_path(paths->runs_dir, entry->d_name, "");
+    char *run_path = (NULL != run_dir)
+                         ? artifact_path(run_dir, COMPILE_PROFILE_NAME, ".gcda")
+                         : NULL;
+
+    // Runs that are still being written are merged next time
+    if (NULL != run_path && 0 == access(run_path, F_OK)) {
+      compile_merge_profile(paths->profile_dir, run_dir);
+      remove(run_path);
+      rmdir(run_dir);
+    }
+
+    safe_free(run_dir);
+    safe_free(run_path);
+  }
+
+  closedir(dir);
+  rmdir(paths->runs_dir);
+}
+
+// Pages are compiled into the artifact store and installed from there
+// Pages whose translation did not change are never compiled again
+int build_compile(const build_paths_t *paths) {
+  mkdir(paths->store_dir, 0755);
+
+  char           flags[FLAGS_MAX_LEN];
+  compile_page_t page = {.flags = read_page_flags(paths, flags)};
+
+  if (compile_get_options() & COMPILE_OPT_PROFILE_USE) {
+    merge_profiles(paths);
+    page.profile_dir = paths->profile_dir;
+  }
+
+  char *entry_path =
+      store_entry_path(paths->store_dir, paths->c_file_path, &page);
+
+  if (NULL == entry_path) {
+    log_fatal("error while producing shared object");
+    return EXIT_FAILURE;
+  }
+
+  // The page is compiled from its last translation, whose inputs are
+  // recorded in its manifest
+  cache_inputs_t *inputs = cache_inputs_load(paths->sum_file_path);
+
+  if (NULL == inputs) {
+    log_fatal("unable to read cache manifest");
+    safe_free(entry_path);
+    return EXIT_FAILURE;
+  }
+
+  build_diag_t diag;
+  capture_diagnostics(&diag);
+
+  // The mark is placed before a fast build is installed, so it is never
+  // missing from an unoptimized page
+  bool ok = mark_upgrade(paths);
+  if (!ok) {
+    log_fatal("unable to create output file");
+  } else if (store_has(entry_path)) {
+    log_info("using shared object from artifact store");
+  } else {
+    ok = EXIT_SUCCESS == compile_to_store(paths, &page, entry_path, &diag);
+  }
+
+  // The shared object is replaced atomically, processes that already
+  // loaded the previous one keep using it
+  ok = ok && EXIT_SUCCESS == store_install(entry_path, paths->so_file_path);
+  safe_free(entry_path);
+
+  if (!ok) {
+    log_fatal("error while producing shared object");
+  }
+
+  record_outcome(paths, &diag, inputs);
+  if (!ok) {
+    cache_inputs_free(inputs);
+    return EXIT_FAILURE;
+  }
+
+  remove(paths->fail_file_path);
+
+  int ret = cache_store(paths->sum_file_path, inputs, paths->so_file_path);
+  cache_inputs_free(inputs);
+
+  if (EXIT_SUCCESS == ret && !(compile_get_options() & COMPILE_OPT_FAST)) {
+    remove(paths->upgrade_file_path);
+  }
+
+  return ret;
+}
+
+// Runs in the background with the page lock claimed by the request
+static int upgrade_job(const build_paths_t *paths, int lock) {
+  int ret = EXIT_SUCCESS;
+  compile_clear_option(COMPILE_OPT_FAST);
+
+  // A page that is no longer fresh is built again by the next request
+  if (build_fresh(paths) && build_pending_upgrade(paths)) {
+    log_info("replacing page with optimized build");
+    ret = build_compile(paths);
+  }
+
+  // Keep serving the unoptimized page rather than failing again on
+  // every request
+  if (EXIT_SUCCESS != ret) {
+    remove(paths->upgrade_file_path);
+  }
+
+  fslock_release(lock);
+  return ret;
+}
+
+// The optimized build runs in a detached process, so that it does not
+// delay the response. In CGI mode the response ends when all holders of
+// stdout have closed it, so the process lets go of stdio
+static void schedule_upgrade(const build_paths_t *paths) {
+  // The page lock is not waited for: whoever holds it is building the
+  // page already, and nothing is forked for it
+  int lock = fslock_acquire(paths->lock_file_path, false);
+  if (0 > lock) {
+    return;
+  }
+
+  fflush(NULL);
+  pid_t pid = fork();
+
+  if (0 < pid) {
+    fslock_detach(lock);
+    waitpid(pid, NULL, 0);
+    return;
+  }
+
+  if (0 > pid) {
+    log_error("unable to start optimized build");
+    fslock_release(lock);
+    return;
+  }
+
+  setsid();
+  int null_fd = open("/dev/null", O_RDWR);
+  if (0 <= null_fd) {
+    dup2(null_fd, STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+  }
+
+  // The intermediate process exits right away and the build process is
+  // adopted by init, no zombie is left to the caller. The lock is handed
+  // over to the build process
+  pid = fork();
+  if (0 != pid) {
+    if (0 > pid) {
+      fslock_release(lock);
+    }
+
+    _exit(EXIT_SUCCESS);
+  }
+
+  _exit(upgrade_job(paths, lock));
+}
+
+int build_page(const build_paths_t *paths) {
+  if (build_fresh(paths)) {
+    if (buildTiered && build_pending_upgrade(paths)) {
+      schedule_upgrade(paths);
+    }
+
+    return EXIT_SUCCESS;
+  }
+
+  if (build_failed(paths)) {
+    return EXIT_FAILURE;
+  }
+
+  int lock = fslock_acquire(paths->lock_file_path, false);
+
+  if (0 > lock) {
+    // Another process is building this page
+    if (0 == access(paths->so_file_path, F_OK)) {
+      log_info("page is being rebuilt, using previous version");
+      return EXIT_SUCCESS;
+    }
+
+    lock = fslock_acquire(paths->lock_file_path, true);
+  }
+
+  // The page is checked again, it may have been built (or failed to
+  // build) while waiting
+  int  ret   = EXIT_SUCCESS;
+  bool fresh = build_fresh(paths);
+  if (!fresh && build_failed(paths)) {
+    ret = EXIT_FAILURE;
+  } else if (!fresh) {
+    if (buildTiered) {
+      compile_set_option(COMPILE_OPT_FAST);
+    }
+
+    ret = build_translate(paths);
+    ret = (EXIT_SUCCESS == ret) ? build_compile(paths) : ret;
+    compile_clear_option(COMPILE_OPT_FAST);
+  }
+
+  fslock_release(lock);
+
+  if (buildTiered && EXIT_SUCCESS == ret && build_pending_upgrade(paths)) {
+    schedule_upgrade(paths);
+  }
+
+  return ret;
+}
+
+int build_record_profile(const build_paths_t *paths) {
+  mkdir(paths->runs_dir, 0755);
+
+  // Each run gets its own directory, as expected by gcov-tool
+  char *run_dir  = artifact_path(paths->runs_dir, "XXXXXX", "");
+  char *run_path = NULL;
+  char *tmp_path = NULL;
+  bool  ok       = false;
+
+  if (NULL == run_dir || NULL == mkdtemp(run_dir)) {
+    log_error("unable to create profile directory");
+    goto cleanup;
+  }
+
+  run_path = artifact_path(run_dir, COMPILE_PROFILE_NAME, ".gcda");
+  tmp_path = (NULL != run_path) ? tmp_path_for(run_path) : NULL;
+
+  if (NULL == tmp_path) {
+    log_fatal("out of memory");
+    rmdir(run_dir);
+    goto cleanup;
+  }
+
+  ok = EXIT_SUCCESS == dump_htmc_profile(paths->so_file_path, tmp_path) &&
+       0 == rename(tmp_path, run_path);
+
+  if (!ok) {
+    remove(tmp_path);
+    rmdir(run_dir);
+  }
+
+cleanup:
+  safe_free(run_dir);
+  safe_free(run_path);
+  safe_free(tmp_path);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Section
+// Whole site
+
+static bool list_append(build_list_t *list, char *path) {
+  if (list->len == list->cap) {
+    size_t new_cap   = (0 == list->cap) ? 64 : list->cap * 2;
+    char **new_paths = realloc(list->paths, new_cap * sizeof(char *));
+
+    if (NULL == new_paths) {
+      return false;
+    }
+
+    list->paths = new_paths;
+    list->cap   = new_cap;
+  }
+
+  list->paths[list->len++] = path;
+  return true;
+}
+
+static void list_free(build_list_t *list) {
+  for (size_t i = 0; i < list->len; i++) {
+    safe_free(list->paths[i]);
+  }
+
+  safe_free(list->paths);
+}
+
+static bool has_src_ext(const char *name) {
+  const char *dot = strrchr(name, '.');
+  return NULL != dot && 0 == strcmp(dot + 1, BUILD_SRC_EXT);
+}
+
+// Collects the paths of all pages under dir_path
+// Paths are built the same way CGI mode receives them (relative to the
+// working directory, without a leading "./")
+static bool collect_pages(const char *dir_path, build_list_t *list) {
+  DIR *dir = opendir(dir_path);
+  if (NULL == dir) {
+    log_error("unable to open directory");
+    return false;
+  }
+
+  bool           ok = true;
+  struct dirent *entry;
+
+  while (ok && NULL != (entry = readdir(dir))) {
+    // Skip ".", ".." and hidden files
+    if ('.' == entry->d_name[0]) {
+      continue;
+    }
+
+    bool  is_cwd = 0 == strcmp(dir_path, ".");
+    char *path   = malloc(strlen(dir_path) + 1 + strlen(entry->d_name) + 1);
+    if (NULL == path) {
+      ok = false;
+      break;
+    }
+
+    if (is_cwd) {
+      strcpy(path, entry->d_name);
+    } else {
+      sprintf(path, "%s/%s", dir_path, entry->d_name);
+    }
+
+    struct stat entry_stat;
+    if (0 != stat(path, &entry_stat)) {
+      safe_free(path);
+      continue;
+    }
+
+    if (S_ISDIR(entry_stat.st_mode)) {
+      ok = collect_pages(path, list);
+      safe_free(path);
+      continue;
+    }
+
+    if (!S_ISREG(entry_stat.st_mode) || !has_src_ext(entry->d_name) ||
+        !list_append(list, path)) {
+      safe_free(path);
+    }
+  }
+
+  closedir(dir);
+  return ok;
+}
+
+static int cmp_paths(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool collect_dep(const char *dep_path, void *arg) {
+  char *path = strdup(dep_path);
+  if (NULL == path || !list_append(arg, path)) {
+    safe_free(path);
+    return false;
+  }
+
+  return true;
+}
+
+static bool is_partial(const build_list_t *included, const char *path) {
+  return NULL != included->paths &&
+         NULL != bsearch(&path,
+                         included->paths,
+                         included->len,
+                         sizeof(char *),
+                         cmp_paths);
+}
+
+// Partials are validated against their translation, as they are never
+// compiled on their own
+static bool partial_fresh(const build_paths_t *paths) {
+  return cache_fresh(paths->sum_file_path, paths->c_file_path);
+}
+
+// Jobs wait for pages being built by CGI requests
+static int translate_job(const build_paths_t *paths) {
+  int lock = fslock_acquire(paths->lock_file_path, true);
+  int ret  = build_translate(paths);
+
+  fslock_release(lock);
+  return ret;
+}
+
+static int compile_job(const build_paths_t *paths) {
+  int  lock = fslock_acquire(paths->lock_file_path, true);
+  bool done = build_fresh(paths) && !build_pending_upgrade(paths);
+  int  ret  = done ? EXIT_SUCCESS : build_compile(paths);
+
+  fslock_release(lock);
+  return ret;
+}
+
+static int object_job(const build_paths_t *paths) {
+  char           sym[BUNDLE_SYM_LEN];
+  char           flags[FLAGS_MAX_LEN];
+  compile_page_t page = {.flags = read_page_flags(paths, flags)};
+
+  bundle_entry_sym(paths->src_path, sym);
+  return compile_c_object(paths->c_file_path, paths->obj_file_path, &page, sym);
+}
+
+// Runs job on all selected pages using up to jobs processes
+// Pages whose job fails are marked as failed and deselected
+static size_t run_jobs(build_paths_t *pages,
+                       bool          *selected,
+                       size_t         num_pages,
+                       int (*job)(const build_paths_t *paths),
+                       int jobs) {
+  pid_t *pids        = calloc(num_pages + 1, sizeof(pid_t));
+  size_t num_failed  = 0;
+  int    num_running = 0;
+  size_t next        = 0;
+
+  while (next < num_pages || 0 < num_running) {
+    if (next < num_pages && num_running < jobs) {
+      size_t i = next++;
+      if (!selected[i]) {
+        continue;
+      }
+
+      // Each page is handled in its own process, translation and
+      // compilation of different pages are independent
+      pid_t pid = (NULL != pids) ? fork() : -1;
+      if (0 == pid) {
+        _exit(job(&pages[i]));
+      }
+
+      if (0 < pid) {
+        pids[i] = pid;
+        num_running++;
+        continue;
+      }
+
+      // Fall back to building in this process if forking is not possible
+      if (EXIT_SUCCESS != job(&pages[i])) {
+        selected[i] = false;
+        num_failed++;
+      }
+
+      continue;
+    }
+
+    int   status;
+    pid_t pid = wait(&status);
+    if (-1 == pid) {
+      break;
+    }
+
+    num_running--;
+    for (size_t i = 0; i < num_pages; i++) {
+      if (pid != pids[i]) {
+        continue;
+      }
+
+      if (!WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status)) {
+        selected[i] = false;
+        num_failed++;
+      }
+
+      pids[i] = 0;
+      break;
+    }
+  }
+
+  safe_free(pids);
+  return num_failed;
+}
+
+static bool has_flag(const char *flags, const char *flag) {
+  size_t      flag_len = strlen(flag);
+  const char *found    = strstr(flags, flag);
+
+  while (NULL != found && ((flags != found && ' ' != found[-1]) ||
+                           (0 != found[flag_len] && ' ' != found[flag_len]))) {
+    found = strstr(found + 1, flag);
+  }
+
+  return NULL != found;
+}
+
+// Libraries needed by any page are needed by the bundle
+static bool append_libs(char *libs, const char *flags) {
+  char *flags_buf = strdup(flags);
+  bool  ok        = NULL != flags_buf;
+
+  for (char *flag = ok ? strtok(flags_buf, " \t") : NULL; ok && NULL != flag;
+       flag       = strtok(NULL, " \t")) {
+    size_t libs_len = strlen(libs);
+
+    if (0 != strncmp(flag, "-l", 2) || has_flag(libs, flag)) {
+      continue;
+    }
+
+    ok = libs_len + 1 + strlen(flag) < FLAGS_MAX_LEN;
+    if (ok) {
+      sprintf(libs + libs_len, " %s", flag);
+    }
+  }
+
+  safe_free(flags_buf);
+  return ok;
+}
+
+// Paths in compiler response files are separated by whitespace
+static void write_response_arg(FILE *objs_file, const char *arg) {
+  for (const char *c = arg; *c; c++) {
+    if (' ' == *c || '\t' == *c || '\\' == *c || '"' == *c || '\'' == *c) {
+      fputc('\\', objs_file);
+    }
+
+    fputc(*c, objs_file);
+  }
+
+  fputc('\n', objs_file);
+}
+
+// The route table and the list of objects are generated next to the
+// pages, the bundle is replaced atomically like a page
+static int link_bundle(const build_paths_t *pages,
+                       const bool          *bundled,
+                       size_t               num_pages,
+                       const char          *tmp_dir,
+                       const char          *bundle_path) {
+  const char **routes     = calloc(num_pages + 1, sizeof(char *));
+  char        *table_path = artifact_path(tmp_dir, BUILD_BUNDLE, ".c");
+  char        *objs_path  = artifact_path(tmp_dir, BUILD_BUNDLE, ".objs");
+  char        *bundle_tmp = tmp_path_for(bundle_path);
+  char        *link_flags = NULL;
+  FILE        *table_file = NULL;
+  FILE        *objs_file  = NULL;
+  size_t       num_routes = 0;
+  int          ret        = EXIT_FAILURE;
+  char         libs[FLAGS_MAX_LEN];
+
+  if (NULL == routes || NULL == table_path || NULL == objs_path ||
+      NULL == bundle_tmp) {
+    log_fatal("out of memory");
+    goto cleanup;
+  }
+
+  // The bundle is linked with the default profile and the libraries of
+  // all pages, other flags of a page only apply to its own object
+  link_flags = config_profile_flags(CONFIG_PATH, CONFIG_DEFAULT_PROFILE);
+  snprintf(libs, sizeof libs, "%s", (NULL != link_flags) ? link_flags : "");
+
+  table_file = fopen(table_path, "w");
+  objs_file  = fopen(objs_path, "w");
+  if (NULL == table_file || NULL == objs_file) {
+    log_fatal("unable to create output file");
+    goto cleanup;
+  }
+
+  for (size_t i = 0; i < num_pages; i++) {
+    char flags[FLAGS_MAX_LEN];
+    if (!bundled[i]) {
+      continue;
+    }
+
+    if (!append_libs(libs, read_page_flags(&pages[i], flags))) {
+      log_fatal("too many compiler flags");
+      goto cleanup;
+    }
+
+    routes[num_routes++] = pages[i].src_path;
+    write_response_arg(objs_file, pages[i].obj_file_path);
+  }
+
+  int  table_ret = bundle_write_table(table_file, routes, num_routes);
+  bool written   = 0 == fclose(table_file);
+  written        = 0 == fclose(objs_file) && written;
+
+  table_file = NULL;
+  objs_file  = NULL;
+
+  if (EXIT_SUCCESS != table_ret) {
+    goto cleanup;
+  }
+
+  if (!written) {
+    log_fatal("unable to create output file");
+    goto cleanup;
+  }
+
+  compile_page_t link = {.flags = libs};
+
+  ret = compile_c_bundle(table_path, objs_path, bundle_tmp, &link);
+
+  if (EXIT_SUCCESS == ret && 0 != rename(bundle_tmp, bundle_path)) {
+    log_fatal("unable to create output file");
+    ret = EXIT_FAILURE;
+  }
+
+cleanup:
+  if (NULL != table_file) {
+    fclose(table_file);
+  }
+
+  if (NULL != objs_file) {
+    fclose(objs_file);
+  }
+
+  if (NULL != bundle_tmp) {
+    remove(bundle_tmp);
+  }
+
+  safe_free(routes);
+  safe_free(table_path);
+  safe_free(objs_path);
+  safe_free(bundle_tmp);
+  safe_free(link_flags);
+  return ret;
+}
+
+// Pages are compiled again for the bundle, as entry points are renamed
+static size_t build_bundle(build_paths_t *pages,
+                           bool          *bundled,
+                           size_t         num_pages,
+                           const char    *tmp_dir,
+                           const char    *bundle_path,
+                           int            jobs) {
+  size_t num_failed = run_jobs(pages, bundled, num_pages, object_job, jobs);
+
+  if (0 == num_failed &&
+      EXIT_SUCCESS !=
+          link_bundle(pages, bundled, num_pages, tmp_dir, bundle_path)) {
+    num_failed++;
+  }
+
+  return num_failed;
+}
+
+// Lists the sources of all pages under root_dir
+static int list_site(const char *root_dir, build_list_t *src_paths) {
+  // Normalize "./dir/" to "dir" to match CGI paths
+  char *root = strdup(root_dir);
+  if (NULL == root) {
+    log_fatal("out of memory");
+    return EXIT_FAILURE;
+  }
+
+  size_t root_len = strlen(root);
+  while (1 < root_len && '/' == root[root_len - 1]) {
+    root[--root_len] = 0;
+  }
+
+  const char *root_rel = root;
+  while ('.' == root_rel[0] && '/' == root_rel[1]) {
+    root_rel += 2;
+  }
+
+  if (0 == root_rel[0]) {
+    root_rel = ".";
+  }
+
+  bool ok = collect_pages(root_rel, src_paths);
+  safe_free(root);
+
+  if (!ok) {
+    log_fatal("unable to list pages");
+    list_free(src_paths);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int build_site(const char *root_dir,
+               const char *tmp_dir,
+               const char *bundle_path,
+               int         jobs) {
+  build_list_t src_paths = {0};
+  build_list_t included  = {0};
+
+  mkdir(tmp_dir, 0755);
+  bool ok = EXIT_SUCCESS == list_site(root_dir, &src_paths);
+  if (!ok) {
+    return EXIT_FAILURE;
+  }
+
+  size_t         num_pages = src_paths.len;
+  build_paths_t *pages     = calloc(num_pages + 1, sizeof(build_paths_t));
+  bool          *translate = calloc(num_pages + 1, sizeof(bool));
+  bool          *compile   = calloc(num_pages + 1, sizeof(bool));
+  bool          *touched   = calloc(num_pages + 1, sizeof(bool));
+  bool          *bundled   = calloc(num_pages + 1, sizeof(bool));
+
+  size_t num_failed     = 0;
+  size_t num_translated = 0;
+  size_t num_compiled   = 0;
+  size_t num_fresh      = 0;
+
+  if (NULL == pages || NULL == translate || NULL == compile ||
+      NULL == touched || NULL == bundled) {
+    log_fatal("out of memory");
+    ok = false;
+    goto cleanup;
+  }
+
+  for (size_t i = 0; i < num_pages; i++) {
+    if (!build_paths_init(&pages[i], tmp_dir, src_paths.paths[i])) {
+      ok = false;
+      goto cleanup;
+    }
+
+    translate[i]    = !build_fresh(&pages[i]) && !partial_fresh(&pages[i]);
+    touched[i]      = translate[i];
+    num_translated += translate[i];
+  }
+
+  // Pages are translated first so that their manifests tell which
+  // sources are only partials included by other pages
+  num_failed += run_jobs(pages, translate, num_pages, translate_job, jobs);
+
+  for (size_t i = 0; ok && i < num_pages; i++) {
+    ok = deps_for_each(pages[i].deps_file_path, collect_dep, &included);
+  }
+
+  if (!ok) {
+    log_fatal("out of memory");
+    goto cleanup;
+  }
+
+  qsort(included.paths, included.len, sizeof(char *), cmp_paths);
+
+  for (size_t i = 0; i < num_pages; i++) {
+    bool translated = !touched[i] || translate[i];
+
+    // Partials are recorded by their translation
+    if (is_partial(&included, pages[i].src_path)) {
+      continue;
+    }
+
+    // Pages built without optimizations by CGI requests are upgraded
+    bool stale = !build_fresh(&pages[i]) || build_pending_upgrade(&pages[i]);
+
+    compile[i]      = translated && stale;
+    bundled[i]      = NULL != bundle_path && translated;
+    num_compiled   += compile[i];
+    num_fresh      += !touched[i] && !compile[i];
+  }
+
+  num_failed += run_jobs(pages, compile, num_pages, compile_job, jobs);
+
+  // Bundles are only linked from a complete build of the site
+  if (NULL != bundle_path && 0 == num_failed) {
+    num_failed +=
+        build_bundle(pages, bundled, num_pages, tmp_dir, bundle_path, jobs);
+  }
+
+  printf("%zu translated, %zu compiled, %zu up to date, %zu failed\n",
+         num_translated,
+         num_compiled,
+         num_fresh,
+         num_failed);
+
+cleanup:
+  for (size_t i = 0; NULL != pages && i < num_pages; i++) {
+    build_paths_free(&pages[i]);
+  }
+
+  safe_free(pages);
+  safe_free(translate);
+  safe_free(compile);
+  safe_free(touched);
+  safe_free(bundled);
+  list_free(&src_paths);
+  list_free(&included);
+  return (ok && 0 == num_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int build_preload(const char *root_dir, const char *tmp_dir, bool warm_up) {
+  build_list_t src_paths = {0};
+  if (EXIT_SUCCESS != list_site(root_dir, &src_paths)) {
+    return EXIT_FAILURE;
+  }
+
+  // Processes that preload the site keep serving it, from then on the
+  // state of its files is kept in memory. Directories that cannot be
+  // watched (no inotify, too many watches) are read from disk as before
+  if (!fscache_watch(root_dir) || !fscache_watch(tmp_dir)) {
+    log_info("site not fully watched, some files are checked on disk");
+  }
+
+  // Warm-up requests share one arena, as the requests of a process do
+  htmc_arena_t *arena = warm_up ? htmc_arena_create(0) : NULL;
+  if (warm_up && NULL == arena) {
+    log_fatal("out of memory");
+    list_free(&src_paths);
+    return EXIT_FAILURE;
+  }
+
+  size_t num_loaded = 0;
+  size_t num_warm   = 0;
+  size_t num_failed = 0;
+
+  for (size_t i = 0; i < src_paths.len; i++) {
+    build_paths_t paths = {0};
+    if (!build_paths_init(&paths, tmp_dir, src_paths.paths[i])) {
+      num_failed++;
+      continue;
+    }
+
+    // Partials and pages that were never built have no shared object
+    if (0 != access(paths.so_file_path, F_OK)) {
+      build_paths_free(&paths);
+      continue;
+    }
+
+    // Pages stay in the registry after they are released
+    load_page_t *page = load_page_preload(paths.so_file_path);
+    if (NULL == page) {
+      log_error("unable to preload page");
+      num_failed++;
+    } else {
+      num_loaded++;
+    }
+
+    if (NULL != page && warm_up) {
+      if (EXIT_SUCCESS == load_page_warm_up(page, arena)) {
+        num_warm++;
+      } else {
+        log_error("unable to warm up page");
+        num_failed++;
+      }
+    }
+
+    load_page_release(page);
+    build_paths_free(&paths);
+  }
+
+  printf("%zu loaded, %zu warmed up, %zu failed\n",
+         num_loaded,
+         num_warm,
+         num_failed);
+
+  // A hint for the memory limit of requests (see -ml)
+  if (warm_up) {
+    printf("%zu bytes allocated by the largest page\n",
+           htmc_arena_stats(arena).high_water);
+  }
+
+  htmc_arena_destroy(arena);
+  list_free(&src_paths);
+  return (0 == num_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
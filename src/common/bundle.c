@@ -0,0 +1,257 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bundle.h"
+#include "emit.h"
+#include "hash.h"
+#include "log.h"
+#include "util.h"
+
+// Seeds tried for a bucket before giving up, buckets rarely need more
+// than a few hundred
+#define BUNDLE_MAX_SEED (1 << 24)
+
+#define BUNDLE_NO_ROUTE SIZE_MAX
+
+typedef struct {
+  size_t route;
+  size_t bucket;
+  size_t bucket_len;
+} bundle_key_t;
+
+// The low bits of FNV-1a only depend on the low bits of its input, so
+// the hash is mixed before it is reduced to a slot
+static uint64_t mix(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static uint32_t route_slot(uint32_t seed, const char *path, uint32_t num) {
+  uint64_t hash = hash_str(HASH_SEED, path) ^ (seed * 0x9e3779b97f4a7c15ULL);
+  return mix(hash) % num;
+}
+
+void bundle_entry_sym(const char *path, char sym[BUNDLE_SYM_LEN]) {
+  sprintf(sym,
+          BUNDLE_SYM_PREFIX "%016llx",
+          (unsigned long long)hash_str(HASH_SEED, path));
+}
+
+// Section
+// Route table
+
+// Larger buckets are placed first, while most slots are still free
+static int cmp_keys(const void *a, const void *b) {
+  const bundle_key_t *key_a = a;
+  const bundle_key_t *key_b = b;
+
+  if (key_a->bucket_len != key_b->bucket_len) {
+    return (key_a->bucket_len > key_b->bucket_len) ? -1 : 1;
+  }
+
+  return (key_a->bucket > key_b->bucket) - (key_a->bucket < key_b->bucket);
+}
+
+// Looks for a seed that sends all routes of a bucket to free slots
+static bool place_bucket(const char        **paths,
+                         const bundle_key_t *keys,
+                         size_t              len,
+                         size_t             *slots,
+                         uint32_t           *bucket_slots,
+                         uint32_t            num_slots,
+                         int32_t            *displacement) {
+  for (uint32_t seed = 1; seed < BUNDLE_MAX_SEED; seed++) {
+    bool placed = true;
+
+    for (size_t i = 0; placed && i < len; i++) {
+      bucket_slots[i] = route_slot(seed, paths[keys[i].route], num_slots);
+      placed          = BUNDLE_NO_ROUTE == slots[bucket_slots[i]];
+
+      for (size_t j = 0; placed && j < i; j++) {
+        placed = bucket_slots[i] != bucket_slots[j];
+      }
+    }
+
+    if (placed) {
+      for (size_t i = 0; i < len; i++) {
+        slots[bucket_slots[i]] = keys[i].route;
+      }
+
+      *displacement = (int32_t)seed;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void write_routes(FILE          *dst_file,
+                         const char   **paths,
+                         const size_t  *slots,
+                         const int32_t *displacements,
+                         uint32_t       num_slots) {
+  char sym[BUNDLE_SYM_LEN];
+
+  fprintf(dst_file, "#include \"libhtmc/libhtmc-bundle.h\"\n\n");
+
+  for (uint32_t i = 0; i < num_slots; i++) {
+    if (BUNDLE_NO_ROUTE != slots[i]) {
+      bundle_entry_sym(paths[slots[i]], sym);
+      fprintf(dst_file,
+              "__attribute__((visibility(\"hidden\"))) void "
+              "%s(htmc_handover_t *htmc_handover);\n",
+              sym);
+    }
+  }
+
+  fprintf(dst_file, "\nstatic const int32_t htmc_displacements[] = {\n");
+  for (uint32_t i = 0; i < num_slots; i++) {
+    fprintf(dst_file, "%d,\n", displacements[i]);
+  }
+
+  fprintf(dst_file, "};\n\nstatic const htmc_route_t htmc_slots[] = {\n");
+  for (uint32_t i = 0; i < num_slots; i++) {
+    if (BUNDLE_NO_ROUTE == slots[i]) {
+      fprintf(dst_file, "{0, 0},\n");
+      continue;
+    }
+
+    bundle_entry_sym(paths[slots[i]], sym);
+    emit_char(dst_file, '{');
+    emit_char(dst_file, '"');
+    for (const char *c = paths[slots[i]]; *c; c++) {
+      emit_char_escaped(dst_file, *c);
+    }
+
+    fprintf(dst_file, "\", %s},\n", sym);
+  }
+
+  fprintf(dst_file,
+          "};\n\nconst htmc_route_table_t " HTMC_BUNDLE_ROUTES_SYM
+          " = {%u, htmc_displacements, htmc_slots};\n",
+          num_slots);
+}
+
+int bundle_write_table(FILE *dst_file, const char **paths, size_t num_routes) {
+  uint32_t      num_slots     = (0 < num_routes) ? num_routes : 1;
+  bundle_key_t *keys          = calloc(num_slots, sizeof(bundle_key_t));
+  size_t       *slots         = calloc(num_slots, sizeof(size_t));
+  size_t       *bucket_lens   = calloc(num_slots, sizeof(size_t));
+  uint32_t     *bucket_slots  = calloc(num_slots, sizeof(uint32_t));
+  int32_t      *displacements = calloc(num_slots, sizeof(int32_t));
+  int           ret           = EXIT_FAILURE;
+
+  if (NULL == keys || NULL == slots || NULL == bucket_lens ||
+      NULL == bucket_slots || NULL == displacements) {
+    log_fatal("out of memory");
+    goto cleanup;
+  }
+
+  for (size_t i = 0; i < num_routes; i++) {
+    keys[i].route  = i;
+    keys[i].bucket = route_slot(0, paths[i], num_slots);
+    bucket_lens[keys[i].bucket]++;
+  }
+
+  for (size_t i = 0; i < num_routes; i++) {
+    keys[i].bucket_len = bucket_lens[keys[i].bucket];
+  }
+
+  for (uint32_t i = 0; i < num_slots; i++) {
+    slots[i] = BUNDLE_NO_ROUTE;
+  }
+
+  // Keys of the same bucket end up next to each other
+  qsort(keys, num_routes, sizeof(bundle_key_t), cmp_keys);
+
+  size_t   start     = 0;
+  uint32_t free_slot = 0;
+
+  while (start < num_routes) {
+    size_t   len    = keys[start].bucket_len;
+    int32_t *bucket = &displacements[keys[start].bucket];
+
+    // Buckets with a single route point straight at a free slot
+    if (1 == len) {
+      while (BUNDLE_NO_ROUTE != slots[free_slot]) {
+        free_slot++;
+      }
+
+      slots[free_slot] = keys[start].route;
+      *bucket          = -(int32_t)free_slot - 1;
+    } else if (!place_bucket(paths,
+                             &keys[start],
+                             len,
+                             slots,
+                             bucket_slots,
+                             num_slots,
+                             bucket)) {
+      log_fatal("unable to build route table");
+      goto cleanup;
+    }
+
+    start += len;
+  }
+
+  write_routes(dst_file, paths, slots, displacements, num_slots);
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  safe_free(keys);
+  safe_free(slots);
+  safe_free(bucket_lens);
+  safe_free(bucket_slots);
+  safe_free(displacements);
+  return ret;
+}
+
+// Section
+// Lookup
+
+htmc_route_fn_t bundle_find(const htmc_route_table_t *table, const char *path) {
+  if (NULL == table || 0 == table->num_slots) {
+    return NULL;
+  }
+
+  uint32_t num_slots    = table->num_slots;
+  int32_t  displacement = table->displacements[route_slot(0, path, num_slots)];
+  uint32_t slot         = (0 > displacement)
+                              ? (uint32_t)(-displacement - 1)
+                              : route_slot(displacement, path, num_slots);
+
+  const htmc_route_t *route = &table->routes[slot];
+  if (NULL == route->path || 0 != strcmp(route->path, path)) {
+    return NULL;
+  }
+
+  return route->entry;
+}
@@ -0,0 +1,647 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "compile.h"
+#include "fscache.h"
+#include "hash.h"
+#include "log.h"
+#include "parse.h"
+#include "util.h"
+
+#define CACHE_MAGIC       "htmc-sum"
+#define CACHE_HEADER_FMT  CACHE_MAGIC " %016" PRIx64 " %016" PRIx64 "\n"
+#define CACHE_HEADER_SCAN CACHE_MAGIC " %" SCNx64 " %" SCNx64
+#define CACHE_ENTRY_FMT                                                 \
+  "%c %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %s\n"
+#define CACHE_ENTRY_SCAN                                                \
+  "%c %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %n"
+#define CACHE_MAX_PATH 4096
+#define CACHE_MAX_LINE (CACHE_MAX_PATH + 128)
+
+#define CACHE_ENTRY_INPUT  'i'
+#define CACHE_ENTRY_OUTPUT 'o'
+#define CACHE_DIAG_MARK    "--\n"
+#define CACHE_MEMO_SIZE    256
+
+typedef struct {
+  char          kind;
+  fscache_sig_t sig;
+  const char   *path;
+} cache_entry_t;
+
+typedef struct cache_memo {
+  char              *sum_path;
+  char              *out_path;
+  uint64_t           env;
+  fscache_sig_t      sum_sig;
+  size_t             num_entries;
+  cache_entry_t     *entries;
+  struct cache_memo *next;
+} cache_memo_t;
+
+cache_memo_t   *cacheMemo[CACHE_MEMO_SIZE];
+pthread_mutex_t cacheMemoLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Section
+// Hashing
+
+static uint64_t env_hash() {
+  int      options = parse_get_options();
+  uint64_t hash    = hash_str(HASH_SEED, EXT_HTMC_BUILD);
+
+  hash = hash_str(hash, compile_signature());
+  return hash_bytes(hash, &options, sizeof options);
+}
+
+static bool hash_input(uint64_t *hash, const char *path) {
+  FILE *file = fopen(path, "r");
+  if (NULL == file) {
+    return false;
+  }
+
+  *hash = hash_str(*hash, path);
+  *hash = hash_file(*hash, file);
+  fclose(file);
+  return true;
+}
+
+// Section
+// Manifest entries
+
+static bool read_entry(FILE *sum_file, char *line, cache_entry_t *entry) {
+  int path_off = 0;
+
+  if (NULL == fgets(line, CACHE_MAX_LINE, sum_file)) {
+    return false;
+  }
+
+  line[strcspn(line, "\n")] = 0;
+  if (6 > sscanf(line,
+                 CACHE_ENTRY_SCAN,
+                 &entry->kind,
+                 &entry->sig.dev,
+                 &entry->sig.ino,
+                 &entry->sig.size,
+                 &entry->sig.mtime_ns,
+                 &entry->sig.ctime_ns,
+                 &path_off) ||
+      0 == path_off) {
+    return false;
+  }
+
+  entry->path = line + path_off;
+  return true;
+}
+
+static bool write_entry(FILE                *sum_file,
+                        char                 kind,
+                        const fscache_sig_t *sig,
+                        const char          *path) {
+  return 0 < fprintf(sum_file,
+                     CACHE_ENTRY_FMT,
+                     kind,
+                     sig->dev,
+                     sig->ino,
+                     sig->size,
+                     sig->mtime_ns,
+                     sig->ctime_ns,
+                     path);
+}
+
+static bool write_cur_entry(FILE *sum_file, char kind, const char *path) {
+  fscache_sig_t sig;
+  return fscache_sig_p(path, &sig) && write_entry(sum_file, kind, &sig, path);
+}
+
+static bool skip_header(FILE *sum_file) {
+  char line[CACHE_MAX_LINE];
+  rewind(sum_file);
+  return NULL != fgets(line, sizeof line, sum_file);
+}
+
+// Rehashes the inputs listed in a manifest
+static bool rehash_inputs(FILE *sum_file, uint64_t *hash) {
+  char          line[CACHE_MAX_LINE];
+  cache_entry_t entry;
+
+  *hash = HASH_SEED;
+  if (!skip_header(sum_file)) {
+    return false;
+  }
+
+  while (read_entry(sum_file, line, &entry)) {
+    if (CACHE_ENTRY_INPUT == entry.kind && !hash_input(hash, entry.path)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Rewrites a manifest with the current signatures of its files
+// This happens when inputs were touched but their contents did not
+// change, so that later checks do not hash them again
+static void refresh_manifest(const char *sum_path,
+                             FILE       *sum_file,
+                             uint64_t    env,
+                             uint64_t    inputs) {
+  char *tmp_path = tmp_path_for(sum_path);
+  if (NULL == tmp_path) {
+    return;
+  }
+
+  FILE *tmp_file = fopen(tmp_path, "w");
+  bool  ok       = NULL != tmp_file && skip_header(sum_file);
+
+  ok = ok && 0 < fprintf(tmp_file, CACHE_HEADER_FMT, env, inputs);
+
+  char          line[CACHE_MAX_LINE];
+  cache_entry_t entry;
+  while (ok && read_entry(sum_file, line, &entry)) {
+    ok = write_cur_entry(tmp_file, entry.kind, entry.path);
+  }
+
+  if (NULL != tmp_file) {
+    ok = 0 == fclose(tmp_file) && ok;
+  }
+
+  if (!ok || 0 != rename(tmp_path, sum_path)) {
+    remove(tmp_path);
+  }
+
+  free(tmp_path);
+}
+
+// Section
+// Remembered verdicts
+
+// Manifests found fresh are kept in memory, so that checking them again
+// only compares signatures. With watched directories (see fscache.h)
+// those come from memory too, and warm checks do not touch the disk
+
+static void memo_free(cache_memo_t *memo) {
+  for (size_t i = 0; NULL != memo && i < memo->num_entries; i++) {
+    free((char *)memo->entries[i].path);
+  }
+
+  if (NULL != memo) {
+    free(memo->entries);
+    free(memo->sum_path);
+    free(memo->out_path);
+    free(memo);
+  }
+}
+
+// Must be called with the memo locked
+static cache_memo_t **memo_find(const char *sum_path) {
+  size_t bucket = hash_str(HASH_SEED, sum_path) % CACHE_MEMO_SIZE;
+
+  cache_memo_t **slot = &cacheMemo[bucket];
+  while (NULL != *slot && 0 != strcmp((*slot)->sum_path, sum_path)) {
+    slot = &(*slot)->next;
+  }
+
+  return slot;
+}
+
+static bool memo_fresh(const char *sum_path, const char *out_path) {
+  fscache_sig_t cur_sig;
+  if (!fscache_sig_p(sum_path, &cur_sig)) {
+    return false;
+  }
+
+  pthread_mutex_lock(&cacheMemoLock);
+  cache_memo_t *memo  = *memo_find(sum_path);
+  bool          fresh = NULL != memo && 0 == strcmp(memo->out_path, out_path);
+
+  fresh = fresh && env_hash() == memo->env;
+  fresh = fresh && fscache_sig_eq(&memo->sum_sig, &cur_sig);
+
+  for (size_t i = 0; fresh && i < memo->num_entries; i++) {
+    const cache_entry_t *entry     = &memo->entries[i];
+    bool                 is_output = CACHE_ENTRY_OUTPUT == entry->kind;
+
+    fresh = fscache_sig_p(is_output ? out_path : entry->path, &cur_sig);
+
+    // Same as in manifest_fresh
+    if (is_output) {
+      cur_sig.ctime_ns = entry->sig.ctime_ns;
+    }
+
+    fresh = fresh && fscache_sig_eq(&entry->sig, &cur_sig);
+  }
+
+  pthread_mutex_unlock(&cacheMemoLock);
+  return fresh;
+}
+
+static bool memo_append(cache_memo_t *memo, const cache_entry_t *entry) {
+  cache_entry_t *entries =
+      realloc(memo->entries, (memo->num_entries + 1) * sizeof(cache_entry_t));
+  if (NULL == entries) {
+    return false;
+  }
+
+  memo->entries = entries;
+
+  cache_entry_t *copy = &entries[memo->num_entries++];
+  *copy               = *entry;
+  copy->path          = strdup(entry->path);
+  return NULL != copy->path;
+}
+
+// The manifest is read again, it may have been refreshed while checked
+static void memo_store(const char *sum_path, const char *out_path) {
+  char          line[CACHE_MAX_LINE];
+  cache_entry_t entry;
+  uint64_t      inputs;
+  FILE         *sum_file = NULL;
+  bool          ok       = false;
+  cache_memo_t *memo     = calloc(1, sizeof(cache_memo_t));
+
+  if (NULL == memo || !fscache_sig_p(sum_path, &memo->sum_sig)) {
+    goto cleanup;
+  }
+
+  sum_file = fopen(sum_path, "r");
+  if (NULL == sum_file || NULL == fgets(line, sizeof line, sum_file) ||
+      2 != sscanf(line, CACHE_HEADER_SCAN, &memo->env, &inputs)) {
+    goto cleanup;
+  }
+
+  ok = true;
+  while (ok && read_entry(sum_file, line, &entry)) {
+    ok = memo_append(memo, &entry);
+  }
+
+  memo->sum_path = strdup(sum_path);
+  memo->out_path = strdup(out_path);
+  ok             = ok && NULL != memo->sum_path && NULL != memo->out_path;
+
+cleanup:
+  if (NULL != sum_file) {
+    fclose(sum_file);
+  }
+
+  if (!ok) {
+    memo_free(memo);
+    return;
+  }
+
+  pthread_mutex_lock(&cacheMemoLock);
+  cache_memo_t **slot = memo_find(sum_path);
+  cache_memo_t  *old  = *slot;
+
+  memo->next = (NULL != old) ? old->next : NULL;
+  *slot      = memo;
+  memo_free(old);
+  pthread_mutex_unlock(&cacheMemoLock);
+}
+
+// Section
+// Public functions
+
+// Failure manifests have no artifact, out_path is NULL for them
+static bool manifest_fresh(const char *sum_path,
+                           FILE       *sum_file,
+                           const char *out_path) {
+  char          line[CACHE_MAX_LINE];
+  cache_entry_t entry;
+  uint64_t      env;
+  uint64_t      inputs;
+  uint64_t      cur_env    = env_hash();
+  bool          fresh      = false;
+  bool          has_output = false;
+  bool          touched    = false;
+
+  if (NULL == fgets(line, sizeof line, sum_file) ||
+      2 != sscanf(line, CACHE_HEADER_SCAN, &env, &inputs) || cur_env != env) {
+    return false;
+  }
+
+  fresh = true;
+  while (fresh && read_entry(sum_file, line, &entry)) {
+    fscache_sig_t cur_sig;
+    bool          is_output = CACHE_ENTRY_OUTPUT == entry.kind;
+
+    // The artifact is identified by its signature rather than its path,
+    // so that the same tmp directory can be reached in different ways
+    if (is_output && NULL == out_path) {
+      fresh = false;
+      break;
+    }
+
+    if (!fscache_sig_p(is_output ? out_path : entry.path, &cur_sig)) {
+      fresh = false;
+      break;
+    }
+
+    // Artifacts may be links to a shared store entry, linking it again
+    // updates its ctime without changing its contents
+    if (is_output) {
+      cur_sig.ctime_ns = entry.sig.ctime_ns;
+    }
+
+    bool same_sig = fscache_sig_eq(&entry.sig, &cur_sig);
+    if (is_output) {
+      // Artifacts are never hashed, any change means they were replaced
+      fresh      = same_sig;
+      has_output = true;
+      continue;
+    }
+
+    touched = touched || !same_sig;
+  }
+
+  fresh = fresh && has_output == (NULL != out_path);
+  if (!fresh || !touched) {
+    return fresh;
+  }
+
+  // Diagnostics would be lost by a refresh, failure manifests are only
+  // checked while their inputs are broken
+  uint64_t cur_inputs;
+  fresh = rehash_inputs(sum_file, &cur_inputs) && cur_inputs == inputs;
+  if (fresh && NULL != out_path) {
+    log_info("inputs touched but unchanged, refreshing manifest");
+    refresh_manifest(sum_path, sum_file, env, inputs);
+  }
+
+  return fresh;
+}
+
+bool cache_fresh(const char *sum_path, const char *out_path) {
+  if (memo_fresh(sum_path, out_path)) {
+    return true;
+  }
+
+  FILE *sum_file = fopen(sum_path, "r");
+  if (NULL == sum_file) {
+    return false;
+  }
+
+  bool fresh = manifest_fresh(sum_path, sum_file, out_path);
+  fclose(sum_file);
+
+  if (fresh) {
+    memo_store(sum_path, out_path);
+  }
+
+  return fresh;
+}
+
+// Diagnostics follow the entries of a failure manifest
+static char *read_diagnostics(FILE *fail_file) {
+  char line[CACHE_MAX_LINE];
+  rewind(fail_file);
+
+  while (NULL != fgets(line, sizeof line, fail_file) &&
+         0 != strcmp(line, CACHE_DIAG_MARK)) {
+    // Skip entries
+  }
+
+  size_t len;
+  char  *diagnostics = NULL;
+  FILE  *diag_file   = open_memstream(&diagnostics, &len);
+
+  if (NULL == diag_file) {
+    return NULL;
+  }
+
+  size_t nread;
+  while (0 < (nread = fread(line, 1, sizeof line, fail_file))) {
+    fwrite(line, 1, nread, diag_file);
+  }
+
+  fclose(diag_file);
+  return diagnostics;
+}
+
+bool cache_failed(const char *fail_path, char **diagnostics) {
+  FILE *fail_file = fopen(fail_path, "r");
+  if (NULL == fail_file) {
+    return false;
+  }
+
+  bool failed = manifest_fresh(fail_path, fail_file, NULL);
+  if (failed && NULL != diagnostics) {
+    *diagnostics = read_diagnostics(fail_file);
+  }
+
+  fclose(fail_file);
+  return failed;
+}
+
+// Section
+// Recorded inputs
+
+struct cache_inputs {
+  FILE    *entries;
+  char    *buf;
+  size_t   len;
+  uint64_t hash;
+  bool     complete;
+};
+
+cache_inputs_t *cache_inputs_create() {
+  cache_inputs_t *inputs = calloc(1, sizeof(cache_inputs_t));
+  if (NULL == inputs) {
+    return NULL;
+  }
+
+  inputs->entries  = open_memstream(&inputs->buf, &inputs->len);
+  inputs->hash     = HASH_SEED;
+  inputs->complete = true;
+
+  if (NULL == inputs->entries) {
+    free(inputs);
+    return NULL;
+  }
+
+  return inputs;
+}
+
+// The signature is taken before the contents are read, a change in
+// between makes the next check hash the file again
+void cache_inputs_add(const char *path,
+                      FILE       *file,
+                      const char *buf,
+                      size_t      len,
+                      void       *arg) {
+  cache_inputs_t *inputs = arg;
+  fscache_sig_t   sig;
+
+  if (NULL == file || !fscache_sig_f(file, &sig)) {
+    inputs->complete = false;
+    return;
+  }
+
+  inputs->hash = hash_str(inputs->hash, path);
+  if (NULL != buf) {
+    inputs->hash = hash_bytes(inputs->hash, buf, len);
+  } else {
+    inputs->hash = hash_file(inputs->hash, file);
+    rewind(file);
+  }
+
+  if (!write_entry(inputs->entries, CACHE_ENTRY_INPUT, &sig, path)) {
+    inputs->complete = false;
+  }
+}
+
+void cache_inputs_add_path(cache_inputs_t *inputs, const char *path) {
+  FILE *file = fopen(path, "r");
+  cache_inputs_add(path, file, NULL, 0, inputs);
+
+  if (NULL != file) {
+    fclose(file);
+  }
+}
+
+cache_inputs_t *cache_inputs_load(const char *sum_path) {
+  FILE           *sum_file = fopen(sum_path, "r");
+  cache_inputs_t *inputs   = cache_inputs_create();
+  char            line[CACHE_MAX_LINE];
+  cache_entry_t   entry;
+  uint64_t        env;
+
+  bool ok = NULL != sum_file && NULL != inputs &&
+            NULL != fgets(line, sizeof line, sum_file) &&
+            2 == sscanf(line, CACHE_HEADER_SCAN, &env, &inputs->hash);
+
+  while (ok && read_entry(sum_file, line, &entry)) {
+    ok = CACHE_ENTRY_INPUT != entry.kind ||
+         write_entry(inputs->entries, entry.kind, &entry.sig, entry.path);
+  }
+
+  if (NULL != sum_file) {
+    fclose(sum_file);
+  }
+
+  if (!ok) {
+    cache_inputs_free(inputs);
+    return NULL;
+  }
+
+  return inputs;
+}
+
+void cache_inputs_free(cache_inputs_t *inputs) {
+  if (NULL != inputs) {
+    fclose(inputs->entries);
+    free(inputs->buf);
+    free(inputs);
+  }
+}
+
+// Section
+// Writing manifests
+
+// Writes a manifest to a temporary file, which the caller renames
+// Failure manifests have no artifact, out_path is NULL for them
+static FILE *write_manifest(const char           *tmp_path,
+                            const cache_inputs_t *inputs,
+                            const char           *out_path) {
+  if (NULL == inputs || !inputs->complete || 0 != fflush(inputs->entries)) {
+    return NULL;
+  }
+
+  FILE *sum_file = (NULL != tmp_path) ? fopen(tmp_path, "w") : NULL;
+  if (NULL == sum_file) {
+    return NULL;
+  }
+
+  uint64_t env = env_hash();
+  bool     ok;
+
+  ok = 0 < fprintf(sum_file, CACHE_HEADER_FMT, env, inputs->hash);
+  ok = ok && inputs->len == fwrite(inputs->buf, 1, inputs->len, sum_file);
+  ok = ok && (NULL == out_path ||
+              write_cur_entry(sum_file, CACHE_ENTRY_OUTPUT, out_path));
+
+  if (!ok) {
+    fclose(sum_file);
+    remove(tmp_path);
+    return NULL;
+  }
+
+  return sum_file;
+}
+
+static int commit_manifest(FILE *sum_file, char *tmp_path, const char *path) {
+  bool ok = NULL != sum_file;
+
+  ok = ok && 0 == fclose(sum_file);
+  ok = ok && 0 == rename(tmp_path, path);
+
+  if (!ok) {
+    log_error("unable to write cache manifest");
+    remove(tmp_path);
+  }
+
+  safe_free(tmp_path);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int cache_store(const char           *sum_path,
+                const cache_inputs_t *inputs,
+                const char           *out_path) {
+  char *tmp_path = tmp_path_for(sum_path);
+  FILE *sum_file = write_manifest(tmp_path, inputs, out_path);
+  return commit_manifest(sum_file, tmp_path, sum_path);
+}
+
+int cache_store_failure(const char           *fail_path,
+                        const cache_inputs_t *inputs,
+                        const char           *diagnostics,
+                        size_t                diagnostics_len) {
+  char *tmp_path  = tmp_path_for(fail_path);
+  FILE *fail_file = write_manifest(tmp_path, inputs, NULL);
+
+  // Failures that depend on missing files are not recorded, as files
+  // that do not exist have no signature to compare
+  if (NULL == fail_file) {
+    safe_free(tmp_path);
+    return EXIT_FAILURE;
+  }
+
+  if (0 > fprintf(fail_file, CACHE_DIAG_MARK) ||
+      diagnostics_len != fwrite(diagnostics, 1, diagnostics_len, fail_file)) {
+    fclose(fail_file);
+    fail_file = NULL;
+  }
+
+  return commit_manifest(fail_file, tmp_path, fail_path);
+}
@@ -23,7 +23,10 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "build.h"
 #include "cli.h"
 #include "compile.h"
 #include "libhtmc/libhtmc-internals.h"
@@ -53,6 +56,26 @@ const char *HTMC_DISPLAY_HELP =
     "\t-o,  --output-path {<file>|<path>}                Set the output file "
     "or directory\n"
     "\t-ll, --log-level  {all|info|warning|error|off}    Set the log level\n"
+    "\t-sp, --specialize-printf                          Translate "
+    "htmc_printf calls with literal formats to direct writes\n"
+    "\t-m,  --minify                                     Collapse "
+    "whitespace and remove comments in static markup\n"
+    "\t-sr, --shared-runtime                             Build and run "
+    "pages against bin/libhtmc.so instead of linking libhtmc.a\n"
+    "\t-as, --artifact-store <path>                      Set the directory "
+    "where compiled pages are stored and shared\n"
+    "\t-tc, --tiered-compilation                         Serve stale "
+    "pages unoptimized while the optimized build runs\n"
+    "\t-pg, --profile {generate|use}                     Build pages that "
+    "record profiles, or pages optimized with them\n"
+    "\t-bn, --bundle <file>                              Build or serve "
+    "all pages from a single shared object\n"
+    "\t-wu, --warm-up                                    Run a request "
+    "through each preloaded page and discard its output\n"
+    "\t-ml, --memory-limit <bytes>                       Limit the "
+    "memory a request can allocate with htmc_alloc\n"
+    "\t-j,  --jobs <number>                              Set the number of "
+    "pages built in parallel\n"
     "\n"
     "Mutually exclusive options:\n"
     "\t-h, --help           Display this message\n"
@@ -60,7 +83,8 @@ const char *HTMC_DISPLAY_HELP =
     "\t-v, --version        Display the htmc version string\n"
     "\t-t, --translate      Transalte htmc source file into C source file\n"
     "\t-c, --compile        Compile a C source file to hmtc shared object\n"
-    // "\t-b, --build          Build shared object from htmc source file\n"
+    "\t-b, --build          Build all htmc source files in a directory\n"
+    "\t-p, --preload        Load all built pages in a directory\n"
     "\t-s, --load-shared    Load and run an htmc shared object\n"
     // "\t-r, --run            Run an htmc source file\n"
     "\n"
@@ -82,6 +106,15 @@ const char *HTMC_DISPLAY_HELP =
     "text\n"
     "\t$ htmc -ns -t test.htmc -o pagegen.c\n"
     "\n"
+    "Example: build all pages under `pages` into `tmp` using 4 jobs\n"
+    "\t$ htmc -ns -b pages -o tmp -j 4\n"
+    "\n"
+    "Example: build all pages under `pages` into the bundle `site.so`\n"
+    "\t$ htmc -ns -b pages -bn site.so\n"
+    "\n"
+    "Example: load and warm up all pages built from `pages`\n"
+    "\t$ htmc -ns -p pages -wu\n"
+    "\n"
     "If no option is specified, the program will launch in CGI mode.\n"
     "This allows other programs to call htmc for on-demande execution.\n";
 
@@ -138,6 +171,20 @@ void print_program_info() {
          "information.\n\n");
 }
 
+// Pages built for the shared runtime need it loaded first
+int prepare_shared_runtime(cli_info_t info) {
+  if (!info.shared_runtime) {
+    return EXIT_SUCCESS;
+  }
+
+  if (NULL == load_htmc_runtime(HTMC_RUNTIME_PATH)) {
+    log_fatal("unable to load shared runtime");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 // Section
 // Handler functions
 // These are for optional flags
@@ -185,6 +232,108 @@ int flag_log_level(cli_info_t *info, const char *next) {
   return EXIT_SUCCESS;
 }
 
+int flag_specialize_printf(cli_info_t *info, const char *next) {
+  parse_set_option(PARSE_OPT_SPECIALIZE_PRINTF);
+  return EXIT_SUCCESS;
+}
+
+int flag_minify(cli_info_t *info, const char *next) {
+  parse_set_option(PARSE_OPT_MINIFY);
+  return EXIT_SUCCESS;
+}
+
+int flag_shared_runtime(cli_info_t *info, const char *next) {
+  info->shared_runtime = true;
+  compile_set_option(COMPILE_OPT_SHARED_RUNTIME);
+  return EXIT_SUCCESS;
+}
+
+int flag_artifact_store(cli_info_t *info, const char *next) {
+  if (NULL == next) {
+    log_fatal("expected value after artifact store flag");
+    return EXIT_FAILURE;
+  }
+
+  build_set_store(next);
+  return EXIT_SUCCESS;
+}
+
+int flag_tiered(cli_info_t *info, const char *next) {
+  build_set_tiered(true);
+  return EXIT_SUCCESS;
+}
+
+int flag_profile(cli_info_t *info, const char *next) {
+  if (NULL == next) {
+    log_fatal("expected value after profile flag");
+    return EXIT_FAILURE;
+  }
+
+  if (0 == strcmp(next, "generate")) {
+    compile_set_option(COMPILE_OPT_PROFILE_GENERATE);
+  } else if (0 == strcmp(next, "use")) {
+    compile_set_option(COMPILE_OPT_PROFILE_USE);
+  } else {
+    log_fatal("unrecognized profile mode");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int flag_bundle(cli_info_t *info, const char *next) {
+  if (NULL == next) {
+    log_fatal("expected value after bundle flag");
+    return EXIT_FAILURE;
+  }
+
+  info->bundle_path = next;
+  return EXIT_SUCCESS;
+}
+
+int flag_warm_up(cli_info_t *info, const char *next) {
+  info->warm_up = true;
+  return EXIT_SUCCESS;
+}
+
+int flag_memory_limit(cli_info_t *info, const char *next) {
+  if (NULL == next) {
+    log_fatal("expected value after memory limit flag");
+    return EXIT_FAILURE;
+  }
+
+  char  *end   = NULL;
+  size_t limit = strtoull(next, &end, 10);
+  if (0 == limit || NULL == end || 0 != *end) {
+    log_fatal("invalid memory limit");
+    return EXIT_FAILURE;
+  }
+
+  info->memory_limit = limit;
+  return EXIT_SUCCESS;
+}
+
+int flag_jobs(cli_info_t *info, const char *next) {
+  if (0 != info->jobs) {
+    log_fatal("multiple jobs flags are not supported");
+    return EXIT_FAILURE;
+  }
+
+  if (NULL == next) {
+    log_fatal("expected value after jobs flag");
+    return EXIT_FAILURE;
+  }
+
+  int jobs = atoi(next);
+  if (0 >= jobs) {
+    log_fatal("invalid number of jobs");
+    return EXIT_FAILURE;
+  }
+
+  info->jobs = jobs;
+  return EXIT_SUCCESS;
+}
+
 // Section
 //
 
@@ -233,7 +382,8 @@ int cli_translate(cli_info_t info) {
     return EXIT_FAILURE;
   }
 
-  int r = parse_and_emit(src_file, dst_file);
+  int r = parse_and_emit_file(
+      src_file, src_file_path, dst_file, NULL, NULL, NULL, NULL);
   if (EXIT_SUCCESS == r) {
     log_info("done");
     return r;
@@ -249,7 +399,52 @@ int cli_compile(cli_info_t info) {
     return EXIT_FAILURE;
   }
 
-  return compile_c_output(info.input_file, info.output_path);
+  return compile_c_output(info.input_file, info.output_path, NULL);
+}
+
+int cli_build(cli_info_t info) {
+  if (NULL == info.input_file) {
+    log_fatal("input directory required but not provided");
+    return EXIT_FAILURE;
+  }
+
+  const char *tmp_dir = info.output_path;
+  int         jobs    = info.jobs;
+
+  // Same defaults as CGI mode so that built pages are picked up
+  SET_IF_NULL(tmp_dir, tmp_dir, "./tmp");
+  if (0 == jobs) {
+    jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+
+  if (0 >= jobs) {
+    jobs = 1;
+  }
+
+  // Counters of bundled pages cannot be told apart
+  if (NULL != info.bundle_path &&
+      (compile_get_options() & COMPILE_OPT_PROFILE_GENERATE)) {
+    log_fatal("bundles cannot be built for profiling");
+    return EXIT_FAILURE;
+  }
+
+  return build_site(info.input_file, tmp_dir, info.bundle_path, jobs);
+}
+
+int cli_preload(cli_info_t info) {
+  if (NULL == info.input_file) {
+    log_fatal("input directory required but not provided");
+    return EXIT_FAILURE;
+  }
+
+  const char *tmp_dir = info.output_path;
+  SET_IF_NULL(tmp_dir, tmp_dir, "./tmp");
+
+  if (EXIT_SUCCESS != prepare_shared_runtime(info)) {
+    return EXIT_FAILURE;
+  }
+
+  return build_preload(info.input_file, tmp_dir, info.warm_up);
 }
 
 int cli_load_shared(cli_info_t info) {
@@ -273,6 +468,7 @@ int cli_load_shared(cli_info_t info) {
   SET_IF_NULL(content_type, content_type, "text/plain");
   SET_IF_NULL(request_body, request_body, "");
 
+  htmc_arena_t   *arena    = htmc_arena_create(info.memory_limit);
   htmc_handover_t handover = {.variant_id     = HTMC_BASE_HANDOVER,
                               .request_method = method,
                               .query_string   = query_string,
@@ -281,12 +477,24 @@ int cli_load_shared(cli_info_t info) {
                               .request_body   = request_body,
                               .vprintf        = impl_debug_vprintf,
                               .puts           = impl_debug_puts,
+                              .write          = impl_debug_write,
+                              .put_int        = impl_base_put_int,
+                              .put_uint       = impl_base_put_uint,
+                              .put_double     = impl_base_put_double,
                               .query_vscanf   = impl_base_query_vscanf,
                               .form_vscanf    = impl_base_form_vscanf,
-                              .alloc          = impl_debug_alloc,
-                              .free           = impl_debug_free};
+                              .alloc          = impl_arena_alloc,
+                              .free           = impl_arena_free,
+                              .arena          = arena};
+
+  if (NULL == arena || EXIT_SUCCESS != prepare_shared_runtime(info)) {
+    htmc_arena_destroy(arena);
+    return EXIT_FAILURE;
+  }
 
-  return run_htmc_so(so_file_path, &handover);
+  int ret = run_htmc_so(so_file_path, &handover);
+  htmc_arena_destroy(arena);
+  return ret;
 }
 
 int cli_run(cli_info_t info) {
@@ -20,54 +20,567 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
-// Temporary fix to avoid issues
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <spawn.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include "compile.h"
 #include "log.h"
 #include "util.h"
 
-#define FMT_STR_LEN 2
-#define OBJ_EXT_LEN 2
-#define SO_EXT_LEN  3
+#define COMPILE_MAX_ARGS 64
+#define COMPILE_BUF_SIZE 4096
+
+// Flags of a page, leaves room for the fixed arguments
+#define COMPILE_MAX_PAGE_ARGS 24
+
+extern char **environ;
+
+// Pages are linked without the C library, they reach the host only
+// through the handover. libhtmc is linked statically into each page
+// unless the shared runtime is used
+static const char *COMPILE_CC        = "gcc";
+static const char *COMPILE_LIBS[]    = {"-l:libhtmc.a", NULL};
+static const char *COMPILE_NO_ARGS[] = {NULL};
+static const char *COMPILE_LEVEL     = "-O2";
+static const char *COMPILE_FAST      = "-O0";
+static const char *COMPILE_FLAGS[]   = {"-fPIC",
+                                        "-shared",
+                                        "-nostdlib",
+                                        "-Iinclude/",
+                                        "-L./bin",
+                                        "-Wl,--exclude-libs,ALL",
+                                        NULL};
+
+// Profiled pages only count branches: value profiles need parts of
+// libgcov that use the C library. Counters are written by the host
+// (see libhtmc-profile.h), so pages always carry their own libhtmc
+static const char *COMPILE_PROFILE_GEN_FLAGS[] = {
+    "-fprofile-arcs",
+    "-fprofile-info-section=htmc_profile",
+    "-DHTMC_PROFILE_GENERATE",
+    "-include",
+    "libhtmc/libhtmc-profile.h",
+    NULL};
+static const char *COMPILE_PROFILE_GEN_LIBS[] = {"-l:libhtmc.a",
+                                                 "-lgcov",
+                                                 NULL};
+// Code that was not reached while profiling is optimized as usual, and
+// so are functions changed since, until they are profiled again
+static const char *COMPILE_PROFILE_USE_FLAGS[] = {"-fprofile-use",
+                                                  "-fprofile-partial-training",
+                                                  "-Wno-missing-profile",
+                                                  "-Wno-coverage-mismatch",
+                                                  NULL};
+
+static const char *COMPILE_PROFILE_TOOL = "gcov-tool";
+
+// Symbols of bundled pages are localized after compilation, which LTO
+// objects do not support, so bundled pages are optimized on their own
+static const char *COMPILE_OBJECT_FLAGS[] = {"-fPIC",
+                                             "-Iinclude/",
+                                             "-fno-lto",
+                                             "-c",
+                                             NULL};
+static const char *COMPILE_OBJCOPY        = "objcopy";
+
+int compileOptions = 0;
+
+void compile_set_option(compile_opt_t opt) {
+  compileOptions |= opt;
+}
+
+void compile_clear_option(compile_opt_t opt) {
+  compileOptions &= ~opt;
+}
+
+int compile_get_options() {
+  return compileOptions;
+}
+
+static const char **compile_libs() {
+  if (compileOptions & COMPILE_OPT_PROFILE_GENERATE) {
+    return COMPILE_PROFILE_GEN_LIBS;
+  }
+
+  if (compileOptions & COMPILE_OPT_SHARED_RUNTIME) {
+    return COMPILE_NO_ARGS;
+  }
+
+  return COMPILE_LIBS;
+}
+
+static const char **compile_profile_flags() {
+  if (compileOptions & COMPILE_OPT_PROFILE_GENERATE) {
+    return COMPILE_PROFILE_GEN_FLAGS;
+  }
+
+  if (compileOptions & COMPILE_OPT_PROFILE_USE) {
+    return COMPILE_PROFILE_USE_FLAGS;
+  }
+
+  return COMPILE_NO_ARGS;
+}
+
+static size_t push_args(const char **argv, size_t argc, const char **args) {
+  for (size_t i = 0; NULL != args[i] && argc < COMPILE_MAX_ARGS - 1; i++) {
+    argv[argc++] = args[i];
+  }
+
+  return argc;
+}
+
+// Reads the pipe until the other end is closed, so that the writer is
+// never blocked on a full pipe while it is waited for
+static void drain_output(int fd) {
+  char    scratch[COMPILE_BUF_SIZE];
+  ssize_t nread;
+
+  while (0 < (nread = read(fd, scratch, sizeof scratch))) {
+    // Discarded
+  }
+}
+
+// Reads everything the compiler writes until it exits
+// Output that does not fit in memory is discarded
+static char *read_output(int fd, size_t *len) {
+  size_t cap = COMPILE_BUF_SIZE;
+  char  *buf = malloc(cap + 1);
+  *len       = 0;
+
+  if (NULL == buf) {
+    drain_output(fd);
+    return NULL;
+  }
+
+  ssize_t nread;
+  while (0 < (nread = read(fd, buf + *len, cap - *len))) {
+    *len += nread;
+
+    if (*len == cap) {
+      char *new_buf = realloc(buf, cap * 2 + 1);
+      if (NULL == new_buf) {
+        log_error("toolchain output too large, discarding the rest");
+        drain_output(fd);
+        break;
+      }
 
-#define STR_FMT_INSTANCES 4
-#define OBJ_EXT_INSTANCES 2
-#define SO_EXT_INSTANCES  1
+      buf = new_buf;
+      cap *= 2;
+    }
+  }
+
+  buf[*len] = 0;
+  return buf;
+}
+
+// Runs a tool of the toolchain and collects everything it prints
+static int run_tool(const char **argv, compile_result_t *result) {
+  int pipe_fds[2];
+  if (0 != pipe(pipe_fds)) {
+    log_error("unable to create toolchain pipe");
+    return EXIT_FAILURE;
+  }
+
+  // Both streams are captured, in CGI mode stdout is the response
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addclose(&actions, pipe_fds[0]);
+  posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDERR_FILENO);
+  posix_spawn_file_actions_addclose(&actions, pipe_fds[1]);
+
+  pid_t pid;
+  int   spawn_ret = posix_spawnp(
+      &pid, argv[0], &actions, NULL, (char *const *)argv, environ);
+
+  posix_spawn_file_actions_destroy(&actions);
+  close(pipe_fds[1]);
+
+  if (0 != spawn_ret) {
+    log_error("unable to start toolchain program");
+    close(pipe_fds[0]);
+    return EXIT_FAILURE;
+  }
 
-const char *BASE_SO_CMD_FMT =
-    "gcc -O2 -fPIC -Iinclude/ -c %s -o %s.o "
-    "&& ld -shared -o %s -L./bin --exclude-libs ALL --start-group "
-    "-l:libhtmc.a %s.o --end-group";
+  result->diagnostics = read_output(pipe_fds[0], &result->diagnostics_len);
+  close(pipe_fds[0]);
+
+  int status;
+  if (-1 == waitpid(pid, &status, 0)) {
+    log_error("unable to wait for toolchain program");
+    return EXIT_FAILURE;
+  }
+
+  if (WIFEXITED(status)) {
+    result->exit_status = WEXITSTATUS(status);
+  }
+
+  return (0 == result->exit_status) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Compiler messages are forwarded as they would appear in a terminal
+static void forward_diagnostics(compile_result_t *result) {
+  if (NULL != result->diagnostics) {
+    fwrite(result->diagnostics, 1, result->diagnostics_len, stderr);
+  }
+
+  compile_result_free(result);
+}
 
-int compile_c_output(const char *src_path, const char *dst_path) {
+// Splits page flags in place, libraries (-l) must follow the source
+// Returns false if there are too many flags
+static bool split_flags(char        *flags,
+                        const char **page_flags,
+                        const char **page_libs) {
+  size_t num_flags = 0;
+  size_t num_libs  = 0;
+
+  for (char *flag = strtok(flags, " \t"); NULL != flag;
+       flag       = strtok(NULL, " \t")) {
+    if (COMPILE_MAX_PAGE_ARGS == num_flags + num_libs) {
+      return false;
+    }
+
+    if (0 == strncmp(flag, "-l", 2)) {
+      page_libs[num_libs++] = flag;
+    } else {
+      page_flags[num_flags++] = flag;
+    }
+  }
+
+  page_flags[num_flags] = NULL;
+  page_libs[num_libs]   = NULL;
+  return true;
+}
+
+int compile_c_output_r(const char           *src_path,
+                       const char           *dst_path,
+                       const compile_page_t *page,
+                       compile_result_t     *result) {
   log_info("compiling source file to shared object");
+  *result = (compile_result_t){.exit_status = -1};
 
-  int          ret_val      = EXIT_SUCCESS;
-  const size_t src_path_len = strlen(src_path);
-  const size_t cmd_len =
-      strlen(BASE_SO_CMD_FMT) - (FMT_STR_LEN * STR_FMT_INSTANCES) +
-      (src_path_len * STR_FMT_INSTANCES - 1) + strlen(dst_path) + 1;
+  if (NULL == src_path || NULL == dst_path) {
+    log_error("source or destination path is NULL");
+    return EXIT_FAILURE;
+  }
 
-  log_info("allocating command buffer");
-  char *cmd = (char *)malloc(cmd_len);
+  const compile_page_t no_page = {0};
+  if (NULL == page) {
+    page = &no_page;
+  }
 
-  if (!cmd) {
+  const char *argv[COMPILE_MAX_ARGS];
+  const char *page_flags[COMPILE_MAX_PAGE_ARGS + 1];
+  const char *page_libs[COMPILE_MAX_PAGE_ARGS + 1];
+  size_t      argc      = 0;
+  char       *dump_dir  = NULL;
+  char       *flags_buf = strdup((NULL != page->flags) ? page->flags : "");
+  int         ret       = EXIT_FAILURE;
+
+  if (NULL == flags_buf) {
     log_fatal("out of memory");
-    ret_val = EXIT_FAILURE;
+    return EXIT_FAILURE;
+  }
+
+  if (!split_flags(flags_buf, page_flags, page_libs)) {
+    log_error("too many compiler flags");
     goto cleanup;
   }
 
-  sprintf(cmd, BASE_SO_CMD_FMT, src_path, src_path, dst_path, src_path);
-  ret_val = system(cmd);
+  // Page flags come last, so that they override the defaults
+  argv[argc++] = COMPILE_CC;
+  argv[argc++] = compile_level();
+  argc         = push_args(argv, argc, COMPILE_FLAGS);
+  argc         = push_args(argv, argc, compile_profile_flags());
+  argc         = push_args(argv, argc, page_flags);
+
+  // The profile is read from <profile_dir>/<COMPILE_PROFILE_NAME>.gcda
+  if (NULL != page->profile_dir &&
+      (compileOptions & COMPILE_OPT_PROFILE_USE)) {
+    dump_dir = malloc(strlen(page->profile_dir) + 2);
+    if (NULL == dump_dir) {
+      log_fatal("out of memory");
+      goto cleanup;
+    }
+
+    sprintf(dump_dir, "%s/", page->profile_dir);
+    argv[argc++] = "-dumpdir";
+    argv[argc++] = dump_dir;
+    argv[argc++] = "-dumpbase";
+    argv[argc++] = COMPILE_PROFILE_NAME;
+  }
+
+  argv[argc++] = "-o";
+  argv[argc++] = dst_path;
+  argv[argc++] = src_path;
+  argc         = push_args(argv, argc, page_libs);
+  argc         = push_args(argv, argc, compile_libs());
+  argv[argc]   = NULL;
 
-  if (EXIT_SUCCESS != ret_val) {
+  ret = run_tool(argv, result);
+
+cleanup:
+  safe_free(dump_dir);
+  safe_free(flags_buf);
+
+  if (EXIT_SUCCESS != ret) {
     log_error("failed to compile source file");
   }
 
+  return ret;
+}
+
+void compile_result_free(compile_result_t *result) {
+  safe_free(result->diagnostics);
+  result->diagnostics     = NULL;
+  result->diagnostics_len = 0;
+}
+
+int compile_c_output(const char           *src_path,
+                     const char           *dst_path,
+                     const compile_page_t *page) {
+  compile_result_t result;
+  int              ret = compile_c_output_r(src_path, dst_path, page, &result);
+
+  forward_diagnostics(&result);
+  return ret;
+}
+
+int compile_c_object(const char           *src_path,
+                     const char           *dst_path,
+                     const compile_page_t *page,
+                     const char           *entry_sym) {
+  log_info("compiling source file to object");
+  const compile_page_t no_page = {0};
+  if (NULL == page) {
+    page = &no_page;
+  }
+
+  compile_result_t result = {.exit_status = -1};
+  const char      *argv[COMPILE_MAX_ARGS];
+  const char      *page_flags[COMPILE_MAX_PAGE_ARGS + 1];
+  const char      *page_libs[COMPILE_MAX_PAGE_ARGS + 1];
+  size_t           argc      = 0;
+  size_t           sym_len   = strlen(entry_sym);
+  char            *flags_buf = strdup((NULL != page->flags) ? page->flags : "");
+  char            *define    = malloc(sizeof "-Dhtmc_main=" + sym_len);
+  char            *keep      = malloc(sizeof "--keep-global-symbol=" + sym_len);
+  int              ret       = EXIT_FAILURE;
+
+  if (NULL == flags_buf || NULL == define || NULL == keep) {
+    log_fatal("out of memory");
+    goto cleanup;
+  }
+
+  // Libraries are passed when linking the bundle
+  if (!split_flags(flags_buf, page_flags, page_libs)) {
+    log_error("too many compiler flags");
+    goto cleanup;
+  }
+
+  sprintf(define, "-Dhtmc_main=%s", entry_sym);
+  argv[argc++] = COMPILE_CC;
+  argv[argc++] = compile_level();
+  argc         = push_args(argv, argc, page_flags);
+  argc         = push_args(argv, argc, COMPILE_OBJECT_FLAGS);
+  argv[argc++] = define;
+  argv[argc++] = "-o";
+  argv[argc++] = dst_path;
+  argv[argc++] = src_path;
+  argv[argc]   = NULL;
+
+  ret = run_tool(argv, &result);
+  forward_diagnostics(&result);
+
+  if (EXIT_SUCCESS != ret) {
+    goto cleanup;
+  }
+
+  sprintf(keep, "--keep-global-symbol=%s", entry_sym);
+  argc         = 0;
+  argv[argc++] = COMPILE_OBJCOPY;
+  argv[argc++] = keep;
+  argv[argc++] = dst_path;
+  argv[argc]   = NULL;
+
+  result = (compile_result_t){.exit_status = -1};
+  ret    = run_tool(argv, &result);
+  forward_diagnostics(&result);
+
 cleanup:
-  safe_free(cmd);
+  safe_free(flags_buf);
+  safe_free(define);
+  safe_free(keep);
+
+  if (EXIT_SUCCESS != ret) {
+    log_error("failed to compile source file");
+  }
+
+  return ret;
+}
+
+int compile_c_bundle(const char           *table_path,
+                     const char           *objs_path,
+                     const char           *dst_path,
+                     const compile_page_t *page) {
+  log_info("linking bundle");
+  const compile_page_t no_page = {0};
+  if (NULL == page) {
+    page = &no_page;
+  }
+
+  compile_result_t result = {.exit_status = -1};
+  const char      *argv[COMPILE_MAX_ARGS];
+  const char      *page_flags[COMPILE_MAX_PAGE_ARGS + 1];
+  const char      *page_libs[COMPILE_MAX_PAGE_ARGS + 1];
+  size_t           argc      = 0;
+  char            *flags_buf = strdup((NULL != page->flags) ? page->flags : "");
+  char            *objs_arg  = malloc(strlen(objs_path) + 2);
+  int              ret       = EXIT_FAILURE;
+
+  if (NULL == flags_buf || NULL == objs_arg) {
+    log_fatal("out of memory");
+    goto cleanup;
+  }
+
+  if (!split_flags(flags_buf, page_flags, page_libs)) {
+    log_error("too many compiler flags");
+    goto cleanup;
+  }
+
+  // Objects are listed in a file, a site may have more pages than
+  // fit on a command line
+  sprintf(objs_arg, "@%s", objs_path);
+  argv[argc++] = COMPILE_CC;
+  argv[argc++] = compile_level();
+  argc         = push_args(argv, argc, COMPILE_FLAGS);
+  argc         = push_args(argv, argc, page_flags);
+  argv[argc++] = "-o";
+  argv[argc++] = dst_path;
+  argv[argc++] = table_path;
+  argv[argc++] = objs_arg;
+  argc         = push_args(argv, argc, page_libs);
+  argc         = push_args(argv, argc, compile_libs());
+  argv[argc]   = NULL;
+
+  ret = run_tool(argv, &result);
+  forward_diagnostics(&result);
+
+cleanup:
+  safe_free(flags_buf);
+  safe_free(objs_arg);
+
+  if (EXIT_SUCCESS != ret) {
+    log_error("failed to link bundle");
+  }
+
+  return ret;
+}
+
+int compile_merge_profile(const char *profile_dir, const char *run_dir) {
+  log_info("merging profile");
+  compile_result_t result = {.exit_status = -1};
+  const char      *argv[COMPILE_MAX_ARGS];
+  size_t           argc = 0;
+
+  // The first run is rewritten rather than copied, so that the profile
+  // gets the summary the compiler expects
+  argv[argc++] = COMPILE_PROFILE_TOOL;
+  if (0 == access(profile_dir, F_OK)) {
+    argv[argc++] = "merge";
+    argv[argc++] = profile_dir;
+  } else {
+    argv[argc++] = "rewrite";
+  }
+
+  argv[argc++] = run_dir;
+  argv[argc++] = "-o";
+  argv[argc++] = profile_dir;
+  argv[argc]   = NULL;
+
+  int ret = run_tool(argv, &result);
+  forward_diagnostics(&result);
+
+  if (EXIT_SUCCESS != ret) {
+    log_error("failed to merge profile");
+  }
+
+  return ret;
+}
+
+// Appends what the compiler prints for a dump option, without newlines
+static void append_dump(char *identity, size_t cap, const char *option) {
+  const char      *argv[] = {COMPILE_CC, option, NULL};
+  compile_result_t result = {.exit_status = -1};
+
+  if (EXIT_SUCCESS == run_tool(argv, &result) &&
+      NULL != result.diagnostics) {
+    result.diagnostics[strcspn(result.diagnostics, "\r\n")] = 0;
+    strncat(identity, " ", cap - strlen(identity) - 1);
+    strncat(identity, result.diagnostics, cap - strlen(identity) - 1);
+  } else {
+    log_error("unable to identify compiler");
+  }
+
+  compile_result_free(&result);
+}
+
+// Version and target of the compiler, asked once per process
+// GCC only answers the first dump option it is given
+static const char *compiler_identity() {
+  static char identity[COMPILE_BUF_SIZE / 4];
+  static bool known = false;
+
+  if (!known) {
+    snprintf(identity, sizeof(identity), "%s", COMPILE_CC);
+    append_dump(identity, sizeof(identity), "-dumpfullversion");
+    append_dump(identity, sizeof(identity), "-dumpmachine");
+    known = true;
+  }
+
+  return identity;
+}
+
+const char *compile_signature() {
+  static char  signature[COMPILE_BUF_SIZE];
+  const char **libs          = compile_libs();
+  const char **profile_flags = compile_profile_flags();
+
+  // Rebuilt every time, options may change after the first call
+  strcpy(signature, compiler_identity());
+
+  for (size_t i = 0; NULL != COMPILE_FLAGS[i]; i++) {
+    strcat(signature, " ");
+    strcat(signature, COMPILE_FLAGS[i]);
+  }
+
+  for (size_t i = 0; NULL != profile_flags[i]; i++) {
+    strcat(signature, " ");
+    strcat(signature, profile_flags[i]);
+  }
+
+  for (size_t i = 0; NULL != libs[i]; i++) {
+    strcat(signature, " ");
+    strcat(signature, libs[i]);
+  }
+
+  return signature;
+}
+
+const char *compile_level() {
+  if (compileOptions & COMPILE_OPT_FAST) {
+    return COMPILE_FAST;
+  }
 
-  return ret_val;
+  return COMPILE_LEVEL;
 }
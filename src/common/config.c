@@ -0,0 +1,89 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+// Splits a line into a profile name and its flags
+// Returns NULL for blank lines and comments
+static char *split_line(char *line, char **flags) {
+  while (isspace((unsigned char)*line)) {
+    line++;
+  }
+
+  if (0 == *line || '#' == *line) {
+    return NULL;
+  }
+
+  char *name = line;
+  while (0 != *line && !isspace((unsigned char)*line)) {
+    line++;
+  }
+
+  if (0 != *line) {
+    *line++ = 0;
+  }
+
+  while (isspace((unsigned char)*line)) {
+    line++;
+  }
+
+  size_t len = strlen(line);
+  while (0 < len && isspace((unsigned char)line[len - 1])) {
+    line[--len] = 0;
+  }
+
+  *flags = line;
+  return name;
+}
+
+char *config_profile_flags(const char *config_path, const char *name) {
+  FILE *config_file = fopen(config_path, "r");
+  if (NULL == config_file) {
+    return NULL;
+  }
+
+  char  *line     = NULL;
+  size_t line_cap = 0;
+  char  *flags    = NULL;
+
+  while (NULL == flags && -1 != getline(&line, &line_cap, config_file)) {
+    char *line_flags;
+    char *line_name = split_line(line, &line_flags);
+
+    if (NULL != line_name && 0 == strcmp(line_name, name)) {
+      flags = strdup(line_flags);
+    }
+  }
+
+  free(line);
+  fclose(config_file);
+  return flags;
+}
@@ -0,0 +1,47 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "deps.h"
+
+#define DEPS_MAX_PATH 4096
+
+bool deps_for_each(const char *manifest_path, deps_fcn_t fcn, void *arg) {
+  FILE *manifest = fopen(manifest_path, "r");
+  if (NULL == manifest) {
+    return true;
+  }
+
+  bool ok = true;
+  char dep_path[DEPS_MAX_PATH];
+
+  while (ok && NULL != fgets(dep_path, sizeof dep_path, manifest)) {
+    dep_path[strcspn(dep_path, "\n")] = 0;
+    ok = fcn(dep_path, arg);
+  }
+
+  fclose(manifest);
+  return ok;
+}
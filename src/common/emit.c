@@ -21,20 +21,32 @@
 // SOFTWARE.
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "emit.h"
 
-#define HTMC_C_BASE                        \
-  "#include \"libhtmc/libhtmc.h\"\n\n"     \
-  "void htmc_main(htmc_handover_t *h) {\n" \
-  "htmc_bind(h);\n"
+#define HTMC_C_BLOB                                     \
+  "__attribute__((visibility(\"hidden\"))) const char " \
+  "htmc_static_blob[]"
 
-#define HTMC_C_BASE_END "}"
+#define HTMC_C_BASE                    \
+  "#include \"libhtmc/libhtmc.h\"\n\n" \
+  "extern " HTMC_C_BLOB ";\n\n"        \
+  "void htmc_main(htmc_handover_t *htmc_handover) {\n"
 
-#define HTMC_HTML_BASE      "htmc_puts("
-#define HTMC_HTML_BLOCK     "\""
-#define HTMC_HTML_BLOCK_END "\""
-#define HTMC_HTML_BASE_END  ");\n"
+#define HTMC_C_BASE_END "}\n"
+
+#define HTMC_HTML_SEGMENT_FMT "htmc_write(htmc_static_blob + %zu, %zu);\n"
+#define HTMC_HTML_BLOB_BASE   "\n" HTMC_C_BLOB " =\n"
+#define HTMC_HTML_BLOB_END    ";\n"
+#define HTMC_HTML_BLOCK       "\""
+#define HTMC_HTML_BLOCK_END   "\"\n"
+
+#define HTMC_EXPR_BASE "htmc_put(("
+#define HTMC_EXPR_END  "));\n"
+
+#define HTMC_BLOB_MIN_CAP 4096
 
 void emit_str(FILE *dst_file, const char *str) {
   fputs(str, dst_file);
@@ -48,46 +60,144 @@ void emit_end(FILE *dst_file) {
   fputs(HTMC_C_BASE_END, dst_file);
 }
 
-void emit_html_base(FILE *dst_file) {
-  fputs(HTMC_HTML_BASE, dst_file);
+void emit_expr_base(FILE *dst_file) {
+  fputs(HTMC_EXPR_BASE, dst_file);
+}
+
+void emit_expr_end(FILE *dst_file) {
+  fputs(HTMC_EXPR_END, dst_file);
+}
+
+void emit_html_segment(FILE *dst_file, size_t offset, size_t len) {
+  fprintf(dst_file, HTMC_HTML_SEGMENT_FMT, offset, len);
+}
+
+void emit_html_blob(FILE *dst_file, const emit_blob_t *blob) {
+  fputs(HTMC_HTML_BLOB_BASE, dst_file);
+
+  // One literal per line of markup to keep the output readable
+  // Adjacent literals are concatenated by the C compiler
+  size_t line_start = 0;
+  do {
+    const char *eol      = NULL;
+    size_t      line_end = blob->len;
+
+    if (line_start < blob->len) {
+      eol = memchr(blob->buf + line_start, '\n', blob->len - line_start);
+    }
+
+    if (NULL != eol) {
+      line_end = eol - blob->buf + 1;
+    }
+
+    fputs(HTMC_HTML_BLOCK, dst_file);
+    emit_html_run(dst_file, blob->buf + line_start, line_end - line_start);
+    fputs(HTMC_HTML_BLOCK_END, dst_file);
+    line_start = line_end;
+  } while (line_start < blob->len);
+
+  fputs(HTMC_HTML_BLOB_END, dst_file);
 }
 
-void emit_html_end(FILE *dst_file) {
-  fputs(HTMC_HTML_BASE_END, dst_file);
+bool emit_blob_append(emit_blob_t *blob, const char *buf, size_t len) {
+  if (blob->len + len > blob->cap) {
+    size_t new_cap = (0 == blob->cap) ? HTMC_BLOB_MIN_CAP : blob->cap;
+    while (blob->len + len > new_cap) {
+      new_cap *= 2;
+    }
+
+    char *new_buf = realloc(blob->buf, new_cap);
+    if (NULL == new_buf) {
+      blob->failed = true;
+      return false;
+    }
+
+    blob->buf = new_buf;
+    blob->cap = new_cap;
+  }
+
+  memcpy(blob->buf + blob->len, buf, len);
+  blob->len += len;
+  return true;
 }
 
-void emit_html_block(FILE *dst_file) {
-  fputs(HTMC_HTML_BLOCK, dst_file);
+bool emit_blob_append_char(emit_blob_t *blob, char chr) {
+  return emit_blob_append(blob, &chr, 1);
 }
 
-void emit_html_block_end(FILE *dst_file) {
-  fputs(HTMC_HTML_BLOCK_END, dst_file);
+void emit_blob_free(emit_blob_t *blob) {
+  free(blob->buf);
+  *blob = (emit_blob_t){0};
 }
 
 void emit_char(FILE *dst_file, char chr) {
   fputc(chr, dst_file);
 }
 
-void emit_char_escaped(FILE *dst_file, char chr) {
+// Returns the C string literal sequence that replaces chr
+// NULL is returned if chr can be copied as-is
+static const char *escape_sequence(char chr, char oct_buf[5]) {
   switch (chr) {
   case '"':
-    emit_str(dst_file, "\\\"");
+    return "\\\"";
 
   case '\\':
-    emit_str(dst_file, "\\\\");
+    return "\\\\";
 
   case '\n':
-    emit_str(dst_file, "\\n");
+    return "\\n";
 
   case '\r':
-    emit_str(dst_file, "\\r");
+    return "\\r";
 
   case '\t':
-    emit_str(dst_file, "    ");
+    return "\\t";
 
   default:
-    if (chr > 31) {
-      emit_char(dst_file, chr);
+    if ((unsigned char)chr > 31) {
+      return NULL;
+    }
+
+    // Other control characters (including NUL) use three octal digits
+    // so that they cannot merge with the digits that follow them
+    sprintf(oct_buf, "\\%03o", (unsigned char)chr);
+    return oct_buf;
+  }
+}
+
+void emit_char_escaped(FILE *dst_file, char chr) {
+  char        oct_buf[5];
+  const char *esc = escape_sequence(chr, oct_buf);
+
+  if (NULL == esc) {
+    emit_char(dst_file, chr);
+    return;
+  }
+
+  emit_str(dst_file, esc);
+}
+
+void emit_buf(FILE *dst_file, const char *buf, size_t len) {
+  fwrite(buf, 1, len, dst_file);
+}
+
+void emit_html_run(FILE *dst_file, const char *run, size_t len) {
+  // Characters that need no escaping are written in spans
+  // rather than one by one
+  size_t span_start = 0;
+  char   oct_buf[5];
+
+  for (size_t i = 0; i < len; i++) {
+    const char *esc = escape_sequence(run[i], oct_buf);
+
+    if (NULL == esc) {
+      continue;
     }
+
+    emit_buf(dst_file, run + span_start, i - span_start);
+    emit_str(dst_file, esc);
+    span_start = i + 1;
   }
+
+  emit_buf(dst_file, run + span_start, len - span_start);
 }
@@ -0,0 +1,460 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "emit.h"
+#include "fmtspec.h"
+
+#define FMTSPEC_FUNC      "htmc_printf"
+#define FMTSPEC_MAX_ARGS  32
+#define FMTSPEC_BLOCK     "{ "
+#define FMTSPEC_BLOCK_END "}"
+
+#define IS_IDENT_CHAR(c)  (isalnum((unsigned char)c) || '_' == c)
+#define IS_ONE_OF(c, set) ('\0' != c && NULL != strchr(set, c))
+
+typedef struct {
+  const char *start;
+  size_t      len;
+} fmtspec_span_t;
+
+// Writers used for each supported conversion
+// The cast reproduces the conversion printf applies to the argument
+// Conversions that keep their spec are formatted on their own by the
+// writer, which receives the spec as its format
+typedef struct {
+  const char *conversion;
+  const char *writer;
+  const char *cast;
+  bool        keeps_spec;
+} fmtspec_conv_t;
+
+static const fmtspec_conv_t FMTSPEC_CONVERSIONS[] = {
+    {"d", "htmc_put_int", "int"},
+    {"i", "htmc_put_int", "int"},
+    {"ld", "htmc_put_int", "long"},
+    {"li", "htmc_put_int", "long"},
+    {"lld", "htmc_put_int", "long long"},
+    {"lli", "htmc_put_int", "long long"},
+    {"u", "htmc_put_uint", "unsigned int"},
+    {"lu", "htmc_put_uint", "unsigned long"},
+    {"llu", "htmc_put_uint", "unsigned long long"},
+    {"zu", "htmc_put_uint", "size_t"},
+    {"c", "htmc_put_char", "char"},
+    {"s", "htmc_put_str", "const char *"},
+    {"f", FMTSPEC_FUNC, "double", true},
+    {"e", FMTSPEC_FUNC, "double", true},
+    {"g", FMTSPEC_FUNC, "double", true},
+};
+
+static size_t skip_space(const char *code, size_t len, size_t i) {
+  while (i < len && isspace((unsigned char)code[i])) {
+    i++;
+  }
+
+  return i;
+}
+
+static bool is_ident(fmtspec_span_t span, const char *ident) {
+  return strlen(ident) == span.len && 0 == strncmp(span.start, ident, span.len);
+}
+
+// Skips a string or character literal starting at i
+// Returns the index after the closing quote or len if unterminated
+static size_t skip_literal(const char *code, size_t len, size_t i) {
+  const char quote = code[i++];
+
+  while (i < len && quote != code[i]) {
+    i += ('\\' == code[i]) ? 2 : 1;
+  }
+
+  return (i < len) ? i + 1 : len;
+}
+
+// Arguments are only moved around if evaluating them has no side effects
+// Calls, assignments and increments are rejected
+static bool is_pure_arg(fmtspec_span_t arg) {
+  char last      = 0;
+  char prev_last = 0;
+
+  for (size_t i = 0; i < arg.len; i++) {
+    const char c    = arg.start[i];
+    const char next = (i + 1 < arg.len) ? arg.start[i + 1] : 0;
+
+    if ('"' == c || '\'' == c) {
+      i         = skip_literal(arg.start, arg.len, i) - 1;
+      prev_last = last;
+      last      = c;
+      continue;
+    }
+
+    if ('(' == c && (IS_IDENT_CHAR(last) || ')' == last || ']' == last)) {
+      return false;
+    }
+
+    if (('+' == c || '-' == c) && c == next) {
+      return false;
+    }
+
+    // Only ==, !=, <= and >= are allowed
+    if ('=' == c && '=' != next && '=' != last &&
+        !(IS_ONE_OF(last, "!<>") && prev_last != last)) {
+      return false;
+    }
+
+    if (!isspace((unsigned char)c)) {
+      prev_last = last;
+      last      = c;
+    }
+  }
+
+  return 0 != arg.len;
+}
+
+// Splits the arguments after the format string
+// Returns the index after the closing parenthesis or 0 on failure
+static size_t split_args(const char     *code,
+                         size_t          len,
+                         size_t          i,
+                         fmtspec_span_t *args,
+                         size_t         *num_args) {
+  *num_args = 0;
+
+  while (i < len && ',' == code[i]) {
+    if (FMTSPEC_MAX_ARGS == *num_args) {
+      return 0;
+    }
+
+    size_t start = skip_space(code, len, i + 1);
+    size_t depth = 0;
+
+    for (i = start; i < len; i++) {
+      const char c = code[i];
+
+      if ('"' == c || '\'' == c) {
+        i = skip_literal(code, len, i) - 1;
+        continue;
+      }
+
+      if (0 == depth && (',' == c || ')' == c)) {
+        break;
+      }
+
+      depth += IS_ONE_OF(c, "([{");
+      depth -= IS_ONE_OF(c, ")]}");
+    }
+
+    size_t end = i;
+    while (end > start && isspace((unsigned char)code[end - 1])) {
+      end--;
+    }
+
+    args[(*num_args)++] = (fmtspec_span_t){code + start, end - start};
+  }
+
+  return (i < len && ')' == code[i]) ? i + 1 : 0;
+}
+
+// Matches precision, length modifiers and conversion specifier after a
+// '%'. Flags and width are not supported, precision only where the spec
+// is kept
+static const fmtspec_conv_t *match_conversion(const char *fmt,
+                                              size_t      len,
+                                              size_t     *conv_len) {
+  size_t prec_len = 0;
+  if (0 < len && '.' == fmt[0]) {
+    for (prec_len = 1;
+         prec_len < len && isdigit((unsigned char)fmt[prec_len]);
+         prec_len++) {
+    }
+  }
+
+  const char *spec = fmt + prec_len;
+  size_t      n    = 0;
+  while (prec_len + n < len && IS_ONE_OF(spec[n], "lz")) {
+    n++;
+  }
+
+  if (prec_len + n++ >= len) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < sizeof FMTSPEC_CONVERSIONS / sizeof(fmtspec_conv_t);
+       i++) {
+    const fmtspec_conv_t *conv = &FMTSPEC_CONVERSIONS[i];
+
+    if (n == strlen(conv->conversion) &&
+        0 == strncmp(spec, conv->conversion, n) &&
+        (0 == prec_len || conv->keeps_spec)) {
+      *conv_len = prec_len + n;
+      return conv;
+    }
+  }
+
+  return NULL;
+}
+
+static void emit_piece(FILE *dst_file, const char *piece, size_t len) {
+  if (0 == len) {
+    return;
+  }
+
+  emit_str(dst_file, "htmc_write_literal(\"");
+  emit_buf(dst_file, piece, len);
+  emit_str(dst_file, "\"); ");
+}
+
+// Checks the format string and emits the specialized call
+// Nothing is emitted if the format cannot be specialized
+static bool emit_specialized(FILE                 *dst_file,
+                             fmtspec_span_t        fmt,
+                             const fmtspec_span_t *args,
+                             size_t                num_args) {
+  const fmtspec_conv_t *convs[FMTSPEC_MAX_ARGS];
+  size_t                conv_lens[FMTSPEC_MAX_ARGS];
+  size_t                num_convs = 0;
+
+  // First pass: validate the format
+  for (size_t i = 0; i < fmt.len; i++) {
+    const char c = fmt.start[i];
+
+    // Octal and hex escapes may hide a '%'
+    if ('\\' == c && i + 1 < fmt.len &&
+        ('x' == fmt.start[i + 1] || isdigit((unsigned char)fmt.start[i + 1]))) {
+      return false;
+    }
+
+    if ('\\' == c) {
+      i++;
+      continue;
+    }
+
+    if ('%' != c) {
+      continue;
+    }
+
+    if (i + 1 < fmt.len && '%' == fmt.start[i + 1]) {
+      i++;
+      continue;
+    }
+
+    size_t                conv_len = 0;
+    const fmtspec_conv_t *conv =
+        match_conversion(fmt.start + i + 1, fmt.len - i - 1, &conv_len);
+
+    if (NULL == conv || num_convs == num_args) {
+      return false;
+    }
+
+    convs[num_convs]       = conv;
+    conv_lens[num_convs++] = conv_len;
+    i += conv_len;
+  }
+
+  if (num_convs != num_args) {
+    return false;
+  }
+
+  for (size_t i = 0; i < num_args; i++) {
+    if (!is_pure_arg(args[i])) {
+      return false;
+    }
+  }
+
+  // Second pass: emit the pieces
+  size_t piece_start = 0;
+  size_t arg_index   = 0;
+
+  emit_str(dst_file, FMTSPEC_BLOCK);
+  for (size_t i = 0; i < fmt.len; i++) {
+    if ('\\' == fmt.start[i]) {
+      i++;
+      continue;
+    }
+
+    if ('%' != fmt.start[i]) {
+      continue;
+    }
+
+    // "%%" is emitted as the first '%' of the pair
+    if ('%' == fmt.start[i + 1]) {
+      emit_piece(dst_file, fmt.start + piece_start, i + 1 - piece_start);
+      piece_start = i + 2;
+      i++;
+      continue;
+    }
+
+    const fmtspec_conv_t *conv     = convs[arg_index];
+    const size_t          conv_len = conv_lens[arg_index];
+    const fmtspec_span_t  arg      = args[arg_index++];
+
+    emit_piece(dst_file, fmt.start + piece_start, i - piece_start);
+    if (conv->keeps_spec) {
+      fprintf(dst_file,
+              "%s(\"%.*s\", (%s)(%.*s)); ",
+              conv->writer,
+              (int)conv_len + 1,
+              fmt.start + i,
+              conv->cast,
+              (int)arg.len,
+              arg.start);
+    } else {
+      fprintf(dst_file,
+              "%s((%s)(%.*s)); ",
+              conv->writer,
+              conv->cast,
+              (int)arg.len,
+              arg.start);
+    }
+
+    i += conv_len;
+    piece_start = i + 1;
+  }
+
+  emit_piece(dst_file, fmt.start + piece_start, fmt.len - piece_start);
+  emit_str(dst_file, FMTSPEC_BLOCK_END);
+  return true;
+}
+
+// Tries to specialize the call whose arguments start at i
+// Returns the index after the terminating ';' or 0 if nothing was emitted
+static size_t try_specialize(FILE       *dst_file,
+                             const char *code,
+                             size_t      len,
+                             size_t      i) {
+  fmtspec_span_t args[FMTSPEC_MAX_ARGS];
+  size_t         num_args = 0;
+
+  i = skip_space(code, len, i);
+  if (i >= len || '(' != code[i]) {
+    return 0;
+  }
+
+  i = skip_space(code, len, i + 1);
+  if (i >= len || '"' != code[i]) {
+    return 0;
+  }
+
+  const size_t fmt_start = i + 1;
+  i                      = skip_literal(code, len, i);
+  if (i >= len || '"' != code[i - 1]) {
+    return 0;
+  }
+
+  fmtspec_span_t fmt = {code + fmt_start, i - 1 - fmt_start};
+
+  i = split_args(code, len, skip_space(code, len, i), args, &num_args);
+  if (0 == i) {
+    return 0;
+  }
+
+  i = skip_space(code, len, i);
+  if (i >= len || ';' != code[i]) {
+    return 0;
+  }
+
+  if (!emit_specialized(dst_file, fmt, args, num_args)) {
+    return 0;
+  }
+
+  return i + 1;
+}
+
+void fmtspec_emit_c(FILE *dst_file, const char *code, size_t len) {
+  // A call can only be replaced by a block if it is a whole statement
+  bool   stmt_start  = true;
+  size_t flush_start = 0;
+
+  for (size_t i = 0; i < len;) {
+    const char c    = code[i];
+    const char next = (i + 1 < len) ? code[i + 1] : 0;
+
+    if (isspace((unsigned char)c)) {
+      i++;
+      continue;
+    }
+
+    if ('"' == c || '\'' == c) {
+      i          = skip_literal(code, len, i);
+      stmt_start = false;
+      continue;
+    }
+
+    if ('/' == c && '/' == next) {
+      const char *eol = memchr(code + i, '\n', len - i);
+      i               = (NULL != eol) ? (size_t)(eol - code) : len;
+      continue;
+    }
+
+    if ('/' == c && '*' == next) {
+      for (i += 3; i < len && !('*' == code[i - 1] && '/' == code[i]); i++) {
+      }
+
+      i++;
+      continue;
+    }
+
+    if (!IS_IDENT_CHAR(c)) {
+      stmt_start = IS_ONE_OF(c, ";{}");
+      i++;
+      continue;
+    }
+
+    const size_t ident_start = i;
+    while (i < len && IS_IDENT_CHAR(code[i])) {
+      i++;
+    }
+
+    const fmtspec_span_t ident       = {code + ident_start, i - ident_start};
+    const bool           replaceable = stmt_start;
+
+    stmt_start = is_ident(ident, "else");
+    if (!replaceable || !is_ident(ident, FMTSPEC_FUNC)) {
+      continue;
+    }
+
+    emit_buf(dst_file, code + flush_start, ident_start - flush_start);
+    size_t end = try_specialize(dst_file, code, len, i);
+
+    if (0 == end) {
+      flush_start = ident_start;
+      continue;
+    }
+
+    // Keep line numbers of the following code unchanged
+    for (size_t j = ident_start; j < end; j++) {
+      if ('\n' == code[j]) {
+        emit_char(dst_file, '\n');
+      }
+    }
+
+    flush_start = end;
+    stmt_start  = true;
+    i           = end;
+  }
+
+  emit_buf(dst_file, code + flush_start, len - flush_start);
+}
@@ -0,0 +1,71 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fsmap.h"
+#include "hash.h"
+
+#define HASH_PRIME    0x100000001b3ULL
+#define HASH_BUF_SIZE 4096
+
+uint64_t hash_bytes(uint64_t seed, const void *buf, size_t len) {
+  const unsigned char *bytes = buf;
+  uint64_t             hash  = seed;
+
+  for (size_t i = 0; i < len; i++) {
+    hash ^= bytes[i];
+    hash *= HASH_PRIME;
+  }
+
+  return hash;
+}
+
+uint64_t hash_str(uint64_t seed, const char *str) {
+  // The terminator is hashed as well so that consecutive strings
+  // cannot be confused with their concatenation
+  return hash_bytes(seed, str, strlen(str) + 1);
+}
+
+uint64_t hash_file(uint64_t seed, FILE *file) {
+  size_t      map_len;
+  const char *map = fsmap_open(file, &map_len);
+
+  if (NULL != map) {
+    uint64_t hash = hash_bytes(seed, map, map_len);
+    fsmap_close(map, map_len);
+    return hash;
+  }
+
+  char     buf[HASH_BUF_SIZE];
+  size_t   nread;
+  uint64_t hash = seed;
+
+  while (0 < (nread = fread(buf, 1, sizeof buf, file))) {
+    hash = hash_bytes(hash, buf, nread);
+  }
+
+  return hash;
+}
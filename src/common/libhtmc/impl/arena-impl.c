@@ -0,0 +1,167 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "libhtmc/libhtmc-internals.h"
+
+#define ARENA_ALIGN      _Alignof(max_align_t)
+#define ARENA_CHUNK_SIZE 8192
+#define ARENA_CHUNK_MAX  (1024 * 1024)
+
+typedef struct htmc_arena_chunk htmc_arena_chunk_t;
+struct htmc_arena_chunk {
+  htmc_arena_chunk_t *next;
+  size_t              size;
+  size_t              used;
+  max_align_t         data[];
+};
+
+struct htmc_arena {
+  htmc_arena_chunk_t *first;
+  htmc_arena_chunk_t *current;
+  size_t              cap;
+  size_t              used;
+  size_t              high_water;
+  size_t              reserved;
+};
+
+htmc_arena_t *htmc_arena_create(size_t cap) {
+  htmc_arena_t *arena = calloc(1, sizeof(htmc_arena_t));
+  if (NULL != arena) {
+    arena->cap = cap;
+  }
+
+  return arena;
+}
+
+// Chunks kept from earlier requests are used again in order, a new one
+// is only allocated when the next one is too small
+static htmc_arena_chunk_t *next_chunk(htmc_arena_t *arena, size_t size) {
+  htmc_arena_chunk_t *cur  = arena->current;
+  htmc_arena_chunk_t *next = (NULL != cur) ? cur->next : arena->first;
+
+  if (NULL != next && size <= next->size) {
+    next->used     = 0;
+    arena->current = next;
+    return next;
+  }
+
+  // Chunks grow with the request, so that large pages need few of them
+  size_t chunk_size = ARENA_CHUNK_SIZE;
+  if (NULL != cur && chunk_size < 2 * cur->size) {
+    chunk_size = 2 * cur->size;
+  }
+
+  if (ARENA_CHUNK_MAX < chunk_size) {
+    chunk_size = ARENA_CHUNK_MAX;
+  }
+
+  if (chunk_size < size) {
+    chunk_size = size;
+  }
+
+  htmc_arena_chunk_t *chunk = malloc(sizeof(htmc_arena_chunk_t) + chunk_size);
+  if (NULL == chunk) {
+    return NULL;
+  }
+
+  chunk->size = chunk_size;
+  chunk->used = 0;
+  chunk->next = next;
+
+  if (NULL != cur) {
+    cur->next = chunk;
+  } else {
+    arena->first = chunk;
+  }
+
+  arena->current   = chunk;
+  arena->reserved += chunk_size;
+  return chunk;
+}
+
+void *htmc_arena_alloc(htmc_arena_t *arena, size_t nbytes) {
+  size_t size = (nbytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  if (NULL == arena || size < nbytes ||
+      (0 != arena->cap && size > arena->cap - arena->used)) {
+    return NULL;
+  }
+
+  htmc_arena_chunk_t *chunk = arena->current;
+  if (NULL == chunk || size > chunk->size - chunk->used) {
+    chunk = next_chunk(arena, size);
+  }
+
+  if (NULL == chunk) {
+    return NULL;
+  }
+
+  void *ptr = (unsigned char *)chunk->data + chunk->used;
+
+  chunk->used += size;
+  arena->used += size;
+  if (arena->high_water < arena->used) {
+    arena->high_water = arena->used;
+  }
+
+  return ptr;
+}
+
+void htmc_arena_reset(htmc_arena_t *arena) {
+  if (NULL != arena) {
+    arena->current = NULL;
+    arena->used    = 0;
+  }
+}
+
+htmc_arena_stats_t htmc_arena_stats(const htmc_arena_t *arena) {
+  return (htmc_arena_stats_t){.cap        = arena->cap,
+                              .used       = arena->used,
+                              .high_water = arena->high_water,
+                              .reserved   = arena->reserved};
+}
+
+void htmc_arena_destroy(htmc_arena_t *arena) {
+  if (NULL == arena) {
+    return;
+  }
+
+  htmc_arena_chunk_t *chunk = arena->first;
+  while (NULL != chunk) {
+    htmc_arena_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+
+  free(arena);
+}
+
+void *impl_arena_alloc(htmc_handover_t *handover, size_t nbytes) {
+  return htmc_arena_alloc(handover->arena, nbytes);
+}
+
+// Memory is given back all at once when the request ends
+void impl_arena_free(htmc_handover_t *handover, void *ptr) {
+}
@@ -21,17 +21,10 @@
 // SOFTWARE.
 
 #include <stdarg.h>
-#include <stdbool.h>
-#include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 
 #include "libhtmc/libhtmc-internals.h"
 
-static uint8_t debugStack[1024]     = {0};
-static size_t  debugStackOffset     = 0;
-static size_t  debugStackLastOffset = 0;
-
 int impl_debug_vprintf(htmc_handover_t *handover,
                        const char      *fmt,
                        va_list          args) {
@@ -42,16 +35,6 @@ int impl_debug_puts(htmc_handover_t *handover, const char *s) {
   return fputs(s, stdout);
 }
 
-void *impl_debug_alloc(htmc_handover_t *handover, size_t nbytes) {
-  if (debugStackOffset >= sizeof debugStack) {
-    return NULL;
-  }
-
-  nbytes += nbytes % 16;
-  size_t offset = debugStackOffset;
-  debugStackOffset += nbytes;
-  return &debugStack[offset];
-}
-
-void impl_debug_free(htmc_handover_t *handover, void *ptr) {
+int impl_debug_write(htmc_handover_t *handover, const char *buf, size_t len) {
+  return fwrite(buf, 1, len, stdout);
 }
@@ -0,0 +1,44 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libhtmc/libhtmc-internals.h"
+
+// Output is formatted and thrown away, so that warm-up requests run the
+// same code as real ones without writing a response
+
+int impl_discard_vprintf(htmc_handover_t *handover,
+                         const char      *fmt,
+                         va_list          args) {
+  return vsnprintf(NULL, 0, fmt, args);
+}
+
+int impl_discard_puts(htmc_handover_t *handover, const char *s) {
+  return strlen(s);
+}
+
+int impl_discard_write(htmc_handover_t *handover, const char *buf, size_t len) {
+  return len;
+}
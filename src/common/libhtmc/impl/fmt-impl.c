@@ -0,0 +1,445 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Number formatting used by the typed writers (htmc_put_*)
+// Integers are converted two digits at a time using a lookup table
+// Doubles are converted with Grisu2 (Florian Loitsch, "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers", 2010),
+// which yields the shortest digits that round-trip in nearly all cases
+// and always digits that round-trip
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libhtmc/libhtmc-internals.h"
+#include "libhtmc/libhtmc.h"
+
+#define FMT_INT_BUF_LEN    20
+#define FMT_DOUBLE_BUF_LEN 32
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS    (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT     (-DP_EXPONENT_BIAS)
+#define DP_EXPONENT_MASK    0x7FF0000000000000ULL
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT       0x0010000000000000ULL
+#define DP_SIGN_MASK        0x8000000000000000ULL
+
+static const char DIGIT_PAIRS[201] = "00010203040506070809"
+                                     "10111213141516171819"
+                                     "20212223242526272829"
+                                     "30313233343536373839"
+                                     "40414243444546474849"
+                                     "50515253545556575859"
+                                     "60616263646566676869"
+                                     "70717273747576777879"
+                                     "80818283848586878889"
+                                     "90919293949596979899";
+
+static const uint32_t POW10[] = {1,
+                                 10,
+                                 100,
+                                 1000,
+                                 10000,
+                                 100000,
+                                 1000000,
+                                 10000000,
+                                 100000000,
+                                 1000000000};
+
+typedef struct {
+  uint64_t f;
+  int      e;
+} diy_fp_t;
+
+// Normalized 10^k for k = -348, -340, ..., 340
+static const diy_fp_t CACHED_POWERS[] = {
+    {0xfa8fd5a0081c0288, -1220},
+    {0xbaaee17fa23ebf76, -1193},
+    {0x8b16fb203055ac76, -1166},
+    {0xcf42894a5dce35ea, -1140},
+    {0x9a6bb0aa55653b2d, -1113},
+    {0xe61acf033d1a45df, -1087},
+    {0xab70fe17c79ac6ca, -1060},
+    {0xff77b1fcbebcdc4f, -1034},
+    {0xbe5691ef416bd60c, -1007},
+    {0x8dd01fad907ffc3c, -980},
+    {0xd3515c2831559a83, -954},
+    {0x9d71ac8fada6c9b5, -927},
+    {0xea9c227723ee8bcb, -901},
+    {0xaecc49914078536d, -874},
+    {0x823c12795db6ce57, -847},
+    {0xc21094364dfb5637, -821},
+    {0x9096ea6f3848984f, -794},
+    {0xd77485cb25823ac7, -768},
+    {0xa086cfcd97bf97f4, -741},
+    {0xef340a98172aace5, -715},
+    {0xb23867fb2a35b28e, -688},
+    {0x84c8d4dfd2c63f3b, -661},
+    {0xc5dd44271ad3cdba, -635},
+    {0x936b9fcebb25c996, -608},
+    {0xdbac6c247d62a584, -582},
+    {0xa3ab66580d5fdaf6, -555},
+    {0xf3e2f893dec3f126, -529},
+    {0xb5b5ada8aaff80b8, -502},
+    {0x87625f056c7c4a8b, -475},
+    {0xc9bcff6034c13053, -449},
+    {0x964e858c91ba2655, -422},
+    {0xdff9772470297ebd, -396},
+    {0xa6dfbd9fb8e5b88f, -369},
+    {0xf8a95fcf88747d94, -343},
+    {0xb94470938fa89bcf, -316},
+    {0x8a08f0f8bf0f156b, -289},
+    {0xcdb02555653131b6, -263},
+    {0x993fe2c6d07b7fac, -236},
+    {0xe45c10c42a2b3b06, -210},
+    {0xaa242499697392d3, -183},
+    {0xfd87b5f28300ca0e, -157},
+    {0xbce5086492111aeb, -130},
+    {0x8cbccc096f5088cc, -103},
+    {0xd1b71758e219652c, -77},
+    {0x9c40000000000000, -50},
+    {0xe8d4a51000000000, -24},
+    {0xad78ebc5ac620000, 3},
+    {0x813f3978f8940984, 30},
+    {0xc097ce7bc90715b3, 56},
+    {0x8f7e32ce7bea5c70, 83},
+    {0xd5d238a4abe98068, 109},
+    {0x9f4f2726179a2245, 136},
+    {0xed63a231d4c4fb27, 162},
+    {0xb0de65388cc8ada8, 189},
+    {0x83c7088e1aab65db, 216},
+    {0xc45d1df942711d9a, 242},
+    {0x924d692ca61be758, 269},
+    {0xda01ee641a708dea, 295},
+    {0xa26da3999aef774a, 322},
+    {0xf209787bb47d6b85, 348},
+    {0xb454e4a179dd1877, 375},
+    {0x865b86925b9bc5c2, 402},
+    {0xc83553c5c8965d3d, 428},
+    {0x952ab45cfa97a0b3, 455},
+    {0xde469fbd99a05fe3, 481},
+    {0xa59bc234db398c25, 508},
+    {0xf6c69a72a3989f5c, 534},
+    {0xb7dcbf5354e9bece, 561},
+    {0x88fcf317f22241e2, 588},
+    {0xcc20ce9bd35c78a5, 614},
+    {0x98165af37b2153df, 641},
+    {0xe2a0b5dc971f303a, 667},
+    {0xa8d9d1535ce3b396, 694},
+    {0xfb9b7cd9a4a7443c, 720},
+    {0xbb764c4ca7a44410, 747},
+    {0x8bab8eefb6409c1a, 774},
+    {0xd01fef10a657842c, 800},
+    {0x9b10a4e5e9913129, 827},
+    {0xe7109bfba19c0c9d, 853},
+    {0xac2820d9623bf429, 880},
+    {0x80444b5e7aa7cf85, 907},
+    {0xbf21e44003acdd2d, 933},
+    {0x8e679c2f5e44ff8f, 960},
+    {0xd433179d9c8cb841, 986},
+    {0x9e19db92b4e31ba9, 1013},
+    {0xeb96bf6ebadf77d9, 1039},
+    {0xaf87023b9bf0ee6b, 1066},
+};
+
+// Section
+// Integers
+
+// Writes value at the end of buf and returns the first digit
+static char *fmt_uint(char *end, unsigned long long value) {
+  char *start = end;
+
+  while (value >= 100) {
+    const unsigned pair = (value % 100) * 2;
+    value /= 100;
+    start -= 2;
+    memcpy(start, &DIGIT_PAIRS[pair], 2);
+  }
+
+  if (value >= 10) {
+    start -= 2;
+    memcpy(start, &DIGIT_PAIRS[value * 2], 2);
+  } else {
+    *--start = '0' + value;
+  }
+
+  return start;
+}
+
+int impl_base_put_int(htmc_handover_t *handover, long long value) {
+  char  buf[FMT_INT_BUF_LEN + 1];
+  char *end = buf + sizeof buf;
+
+  // Negate as unsigned to handle LLONG_MIN
+  unsigned long long abs_value =
+      (0 > value) ? -(unsigned long long)value : (unsigned long long)value;
+  char *start = fmt_uint(end, abs_value);
+
+  if (0 > value) {
+    *--start = '-';
+  }
+
+  return handover->write(handover, start, end - start);
+}
+
+int impl_base_put_uint(htmc_handover_t *handover, unsigned long long value) {
+  char  buf[FMT_INT_BUF_LEN];
+  char *end   = buf + sizeof buf;
+  char *start = fmt_uint(end, value);
+
+  return handover->write(handover, start, end - start);
+}
+
+// Section
+// Doubles (Grisu2)
+
+static diy_fp_t fp_sub(diy_fp_t x, diy_fp_t y) {
+  return (diy_fp_t){x.f - y.f, x.e};
+}
+
+static diy_fp_t fp_mul(diy_fp_t x, diy_fp_t y) {
+  unsigned __int128 p = (unsigned __int128)x.f * y.f;
+  uint64_t          h = p >> 64;
+  uint64_t          l = (uint64_t)p;
+
+  // Round to nearest
+  h += l >> 63;
+  return (diy_fp_t){h, x.e + y.e + 64};
+}
+
+static diy_fp_t fp_normalize(diy_fp_t x) {
+  int shift = __builtin_clzll(x.f);
+  return (diy_fp_t){x.f << shift, x.e - shift};
+}
+
+static void fp_boundaries(diy_fp_t v, diy_fp_t *minus, diy_fp_t *plus) {
+  *plus = fp_normalize((diy_fp_t){(v.f << 1) + 1, v.e - 1});
+
+  // The lower boundary is closer if v is a power of two
+  if (DP_HIDDEN_BIT == v.f) {
+    *minus = (diy_fp_t){(v.f << 2) - 1, v.e - 2};
+  } else {
+    *minus = (diy_fp_t){(v.f << 1) - 1, v.e - 1};
+  }
+
+  minus->f <<= minus->e - plus->e;
+  minus->e = plus->e;
+}
+
+static diy_fp_t cached_power(int e, int *k) {
+  // ceil((-61 - e) * log10(2)) + 347, without libm
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int    ik = (int)dk;
+  if (dk - ik > 0.0) {
+    ik++;
+  }
+
+  unsigned index = (ik >> 3) + 1;
+  *k             = -(-348 + (int)(index << 3));
+  return CACHED_POWERS[index];
+}
+
+static int count_digits(uint32_t n) {
+  int digits = 1;
+  while (digits < 10 && n >= POW10[digits]) {
+    digits++;
+  }
+
+  return digits;
+}
+
+static void grisu_round(char    *buf,
+                        int      len,
+                        uint64_t delta,
+                        uint64_t rest,
+                        uint64_t ten_kappa,
+                        uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+static int digit_gen(diy_fp_t w,
+                     diy_fp_t mp,
+                     uint64_t delta,
+                     char    *buf,
+                     int     *k) {
+  const diy_fp_t one   = {1ULL << -mp.e, mp.e};
+  const diy_fp_t wp_w  = fp_sub(mp, w);
+  uint32_t       p1    = mp.f >> -one.e;
+  uint64_t       p2    = mp.f & (one.f - 1);
+  int            kappa = count_digits(p1);
+  int            len   = 0;
+
+  while (kappa > 0) {
+    const uint32_t d = p1 / POW10[kappa - 1];
+    p1 %= POW10[kappa - 1];
+
+    if (0 != d || 0 != len) {
+      buf[len++] = '0' + d;
+    }
+
+    kappa--;
+    const uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+    if (tmp <= delta) {
+      *k += kappa;
+      grisu_round(
+          buf, len, delta, tmp, (uint64_t)POW10[kappa] << -one.e, wp_w.f);
+      return len;
+    }
+  }
+
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    const char d = p2 >> -one.e;
+
+    if (0 != d || 0 != len) {
+      buf[len++] = '0' + d;
+    }
+
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      const uint64_t unit = (-kappa < 10) ? POW10[-kappa] : 0;
+      grisu_round(buf, len, delta, p2, one.f, wp_w.f * unit);
+      return len;
+    }
+  }
+}
+
+// Produces the shortest digits of v (> 0) and their decimal exponent k
+static int grisu2(uint64_t bits, char *buf, int *k) {
+  const int      biased_e    = (bits & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE;
+  const uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+  diy_fp_t       v;
+
+  if (0 != biased_e) {
+    v = (diy_fp_t){significand + DP_HIDDEN_BIT, biased_e - DP_EXPONENT_BIAS};
+  } else {
+    v = (diy_fp_t){significand, DP_MIN_EXPONENT + 1};
+  }
+
+  diy_fp_t w_m;
+  diy_fp_t w_p;
+  fp_boundaries(v, &w_m, &w_p);
+
+  const diy_fp_t c_mk = cached_power(w_p.e, k);
+  const diy_fp_t w    = fp_mul(fp_normalize(v), c_mk);
+  diy_fp_t       wp   = fp_mul(w_p, c_mk);
+  diy_fp_t       wm   = fp_mul(w_m, c_mk);
+
+  wm.f++;
+  wp.f--;
+  return digit_gen(w, wp, wp.f - wm.f, buf, k);
+}
+
+static char *fmt_exponent(char *dst, int exp) {
+  *dst++ = 'e';
+  *dst++ = (0 > exp) ? '-' : '+';
+  exp    = (0 > exp) ? -exp : exp;
+
+  char  buf[4];
+  char *end   = buf + sizeof buf;
+  char *start = fmt_uint(end, exp);
+  memcpy(dst, start, end - start);
+  return dst + (end - start);
+}
+
+// Lays out len digits with decimal exponent k like JavaScript does:
+// fixed notation for 1e-7 < |v| < 1e21, exponential notation otherwise
+static char *fmt_digits(char *dst, const char *digits, int len, int k) {
+  const int kk = len + k; // 10^(kk - 1) <= v < 10^kk
+
+  if (0 <= k && kk <= 21) {
+    // 1234e7 -> 12340000000
+    memcpy(dst, digits, len);
+    memset(dst + len, '0', k);
+    return dst + kk;
+  }
+
+  if (0 < kk && kk <= 21) {
+    // 1234e-2 -> 12.34
+    memcpy(dst, digits, kk);
+    dst[kk] = '.';
+    memcpy(dst + kk + 1, digits + kk, len - kk);
+    return dst + len + 1;
+  }
+
+  if (-6 < kk && kk <= 0) {
+    // 1234e-6 -> 0.001234
+    dst[0] = '0';
+    dst[1] = '.';
+    memset(dst + 2, '0', -kk);
+    memcpy(dst + 2 - kk, digits, len);
+    return dst + 2 - kk + len;
+  }
+
+  // 1234e30 -> 1.234e+33
+  *dst++ = digits[0];
+  if (1 < len) {
+    *dst++ = '.';
+    memcpy(dst, digits + 1, len - 1);
+    dst += len - 1;
+  }
+
+  return fmt_exponent(dst, kk - 1);
+}
+
+int impl_base_put_double(htmc_handover_t *handover, double value) {
+  char     buf[FMT_DOUBLE_BUF_LEN];
+  char    *end = buf;
+  uint64_t bits;
+
+  memcpy(&bits, &value, sizeof bits);
+  if (bits & DP_SIGN_MASK) {
+    *end++ = '-';
+    bits &= ~DP_SIGN_MASK;
+  }
+
+  if (DP_EXPONENT_MASK == (bits & DP_EXPONENT_MASK)) {
+    if (bits & DP_SIGNIFICAND_MASK) {
+      return handover->write(handover, "nan", 3);
+    }
+
+    memcpy(end, "inf", 3);
+    return handover->write(handover, buf, end + 3 - buf);
+  }
+
+  if (0 == bits) {
+    *end++ = '0';
+    return handover->write(handover, buf, end - buf);
+  }
+
+  char digits[FMT_INT_BUF_LEN];
+  int  k   = 0;
+  int  len = grisu2(bits, digits, &k);
+
+  end = fmt_digits(end, digits, len, k);
+  return handover->write(handover, buf, end - buf);
+}
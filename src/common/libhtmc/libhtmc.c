@@ -26,69 +26,101 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#define HTMC_EXPLICIT_HANDOVER
 #include "libhtmc/libhtmc.h"
 
-static htmc_handover_t *targetHandover;
-
-void htmc_bind(htmc_handover_t *handover) {
-  targetHandover = handover;
-}
-
-int htmc_printf(const char *fmt, ...) {
+int htmc_printf(htmc_handover_t *handover, const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
-  int r = htmc_vprintf(fmt, args);
+  int r = htmc_vprintf(handover, fmt, args);
   va_end(args);
   return r;
 }
 
-int htmc_vprintf(const char *fmt, va_list args) {
-  return targetHandover->vprintf(targetHandover, fmt, args);
+int htmc_vprintf(htmc_handover_t *handover, const char *fmt, va_list args) {
+  return handover->vprintf(handover, fmt, args);
+}
+
+int htmc_puts(htmc_handover_t *handover, const char *s) {
+  return handover->puts(handover, s);
+}
+
+int htmc_write(htmc_handover_t *handover, const char *buf, size_t len) {
+  return handover->write(handover, buf, len);
+}
+
+int htmc_put_int(htmc_handover_t *handover, long long value) {
+  return handover->put_int(handover, value);
+}
+
+int htmc_put_uint(htmc_handover_t *handover, unsigned long long value) {
+  return handover->put_uint(handover, value);
+}
+
+int htmc_put_double(htmc_handover_t *handover, double value) {
+  return handover->put_double(handover, value);
+}
+
+int htmc_put_char(htmc_handover_t *handover, char value) {
+  return htmc_write(handover, &value, 1);
+}
+
+int htmc_put_str(htmc_handover_t *handover, const char *value) {
+  // Same as what glibc's printf prints for a NULL %s
+  if (NULL == value) {
+    return htmc_write(handover, "(null)", 6);
+  }
+
+  return htmc_puts(handover, value);
 }
 
-int htmc_puts(const char *s) {
-  return targetHandover->puts(targetHandover, s);
+int htmc_put_strn(htmc_handover_t *handover, const char *value, size_t len) {
+  return htmc_write(handover, value, len);
 }
 
-int htmc_query_scanf(const char *fmt, ...) {
+int htmc_query_scanf(htmc_handover_t *handover, const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
-  int r = htmc_query_vscanf(fmt, args);
+  int r = htmc_query_vscanf(handover, fmt, args);
   va_end(args);
   return r;
 }
 
-int htmc_query_vscanf(const char *fmt, va_list args) {
-  return targetHandover->query_vscanf(targetHandover, fmt, args);
+int htmc_query_vscanf(htmc_handover_t *handover,
+                      const char      *fmt,
+                      va_list          args) {
+  return handover->query_vscanf(handover, fmt, args);
 }
 
-int htmc_form_scanf(const char *fmt, ...) {
+int htmc_form_scanf(htmc_handover_t *handover, const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
-  int r = htmc_form_vscafn(fmt, args);
+  int r = htmc_form_vscafn(handover, fmt, args);
   va_end(args);
   return r;
 }
 
-int htmc_form_vscafn(const char *fmt, va_list args) {
-  return targetHandover->form_vscanf(targetHandover, fmt, args);
+int htmc_form_vscafn(htmc_handover_t *handover,
+                     const char      *fmt,
+                     va_list          args) {
+  return handover->form_vscanf(handover, fmt, args);
 }
 
-void *htmc_alloc(size_t nbytes) {
-  return targetHandover->alloc(targetHandover, nbytes);
+void *htmc_alloc(htmc_handover_t *handover, size_t nbytes) {
+  return handover->alloc(handover, nbytes);
 }
 
-void htmc_free(void *ptr) {
-  targetHandover->free(targetHandover, ptr);
+void htmc_free(htmc_handover_t *handover, void *ptr) {
+  handover->free(handover, ptr);
 }
 
-void htmc_error(const char *fmt, ...) {
+void htmc_error(htmc_handover_t *handover, const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
-  htmc_verror(fmt, args);
+  htmc_verror(handover, fmt, args);
   va_end(args);
 }
 
-void htmc_verror(const char *fmt, va_list args) {
-  htmc_vprintf(fmt, args);
+void htmc_verror(htmc_handover_t *handover, const char *fmt, va_list args) {
+  htmc_vprintf(handover, fmt, args);
 }
@@ -20,21 +20,67 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <dlfcn.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "bundle.h"
+#include "fscache.h"
+#include "hash.h"
+#include "libhtmc/libhtmc-bundle.h"
+#include "libhtmc/libhtmc-internals.h"
+#include "libhtmc/libhtmc-profile.h"
 #include "libhtmc/libhtmc.h"
 #include "load.h"
 #include "log.h"
 
-void *load_htmc_so(const char *so_file_path) {
+#define LOAD_REGISTRY_SIZE 256
+#define LOAD_ALIAS_MAX_LEN 48
+
+struct load_page {
+  char              *path;
+  void              *handle;
+  htmc_entry_point_t entry;
+  fscache_sig_t      sig;
+  size_t             refs;
+  load_page_t       *next;
+};
+
+load_page_t    *loadRegistry[LOAD_REGISTRY_SIZE];
+pthread_mutex_t loadRegistryLock = PTHREAD_MUTEX_INITIALIZER;
+unsigned long   loadGeneration   = 0;
+
+void *load_htmc_runtime(const char *runtime_path) {
+  log_info("loading shared runtime");
+  if (!runtime_path) {
+    log_error("shared runtime path is NULL");
+    return NULL;
+  }
+
+  // Symbols of global objects are visible to all objects loaded later
+  return dlopen(runtime_path, RTLD_NOW | RTLD_GLOBAL);
+}
+
+static void *load_so(const char *so_file_path, int mode) {
   log_info("loading shared object");
   if (!so_file_path) {
     log_error("shared object path is NULL");
     return NULL;
   }
 
-  return dlopen(so_file_path, RTLD_LAZY);
+  return dlopen(so_file_path, mode);
+}
+
+void *load_htmc_so(const char *so_file_path) {
+  return load_so(so_file_path, RTLD_LAZY);
 }
 
 htmc_entry_point_t get_htmc_entry_point(void *so_handle) {
@@ -54,10 +100,271 @@ int call_htmc_entry(htmc_entry_point_t entry_point, htmc_handover_t *handover) {
     return EXIT_FAILURE;
   }
 
-  return entry_point(handover);
+  entry_point(handover);
+  return EXIT_SUCCESS;
 }
 
 int run_htmc_so(const char *so_file_path, htmc_handover_t *handover) {
-  return call_htmc_entry(get_htmc_entry_point(load_htmc_so(so_file_path)),
-                         handover);
+  load_page_t *page = load_page_acquire(so_file_path);
+  int          ret  = call_htmc_entry(load_page_entry(page), handover);
+
+  load_page_release(page);
+  return ret;
+}
+
+// Section
+// Page registry
+
+// Linking a file changes its ctime, which says nothing about its contents
+static bool same_version(const fscache_sig_t *s1, const fscache_sig_t *s2) {
+  return s1->dev == s2->dev && s1->ino == s2->ino && s1->size == s2->size &&
+         s1->mtime_ns == s2->mtime_ns;
+}
+
+// The loader hands out objects already loaded under the same name, so a
+// new version of a resident object is loaded through a link with a name
+// of its own. The link is removed right away, the object stays mapped
+static void *load_version(const char *so_file_path, int mode) {
+  void *resident = dlopen(so_file_path, RTLD_LAZY | RTLD_NOLOAD);
+  if (NULL == resident) {
+    return load_so(so_file_path, mode);
+  }
+
+  dlclose(resident);
+  char *alias = malloc(strlen(so_file_path) + LOAD_ALIAS_MAX_LEN);
+  if (NULL == alias) {
+    return NULL;
+  }
+
+  sprintf(alias, "%s.%ld.%lu", so_file_path, (long)getpid(), loadGeneration++);
+
+  void *handle;
+  if (0 == link(so_file_path, alias)) {
+    handle = load_so(alias, mode);
+    remove(alias);
+  } else {
+    // Without links, a new version is only loaded once the previous one
+    // has been unloaded
+    handle = load_so(so_file_path, mode);
+  }
+
+  free(alias);
+  return handle;
+}
+
+static load_page_t *load_new_page(const char          *so_file_path,
+                                  const fscache_sig_t *sig,
+                                  int                  mode) {
+  load_page_t *page = calloc(1, sizeof(load_page_t));
+  if (NULL == page) {
+    return NULL;
+  }
+
+  page->path   = strdup(so_file_path);
+  page->handle = (NULL != page->path) ? load_version(so_file_path, mode) : NULL;
+  page->entry  = get_htmc_entry_point(page->handle);
+  page->sig    = *sig;
+
+  if (NULL == page->entry) {
+    if (NULL != page->handle) {
+      dlclose(page->handle);
+    }
+
+    free(page->path);
+    free(page);
+    return NULL;
+  }
+
+  return page;
+}
+
+// Must be called with the registry locked
+static void drop_page(load_page_t *page) {
+  if (NULL == page || 0 != --page->refs) {
+    return;
+  }
+
+  dlclose(page->handle);
+  free(page->path);
+  free(page);
+}
+
+static load_page_t *acquire_page(const char *so_file_path, int mode) {
+  fscache_sig_t sig;
+  if (NULL == so_file_path || !fscache_sig_p(so_file_path, &sig)) {
+    log_error("unable to find shared object");
+    return NULL;
+  }
+
+  size_t bucket = hash_str(HASH_SEED, so_file_path) % LOAD_REGISTRY_SIZE;
+  pthread_mutex_lock(&loadRegistryLock);
+
+  load_page_t **slot = &loadRegistry[bucket];
+  while (NULL != *slot && 0 != strcmp((*slot)->path, so_file_path)) {
+    slot = &(*slot)->next;
+  }
+
+  load_page_t *page = *slot;
+  if (NULL != page && same_version(&page->sig, &sig)) {
+    page->refs++;
+    pthread_mutex_unlock(&loadRegistryLock);
+    return page;
+  }
+
+  // Pages are loaded with the registry locked, so that concurrent
+  // requests for a replaced page load it only once
+  load_page_t *new_page = load_new_page(so_file_path, &sig, mode);
+  if (NULL != new_page) {
+    // Held by the registry and by the caller
+    new_page->refs = 2;
+    new_page->next = (NULL != page) ? page->next : NULL;
+    *slot          = new_page;
+    drop_page(page);
+  }
+
+  pthread_mutex_unlock(&loadRegistryLock);
+  return new_page;
+}
+
+load_page_t *load_page_acquire(const char *so_file_path) {
+  return acquire_page(so_file_path, RTLD_LAZY);
+}
+
+load_page_t *load_page_preload(const char *so_file_path) {
+  return acquire_page(so_file_path, RTLD_NOW);
+}
+
+htmc_entry_point_t load_page_entry(const load_page_t *page) {
+  return (NULL != page) ? page->entry : NULL;
+}
+
+int load_page_warm_up(load_page_t *page, htmc_arena_t *arena) {
+  htmc_handover_t handover = {.variant_id     = HTMC_BASE_HANDOVER,
+                              .request_method = "GET",
+                              .query_string   = "",
+                              .content_length = 0,
+                              .content_type   = "text/plain",
+                              .request_body   = "",
+                              .vprintf        = impl_discard_vprintf,
+                              .puts           = impl_discard_puts,
+                              .write          = impl_discard_write,
+                              .put_int        = impl_base_put_int,
+                              .put_uint       = impl_base_put_uint,
+                              .put_double     = impl_base_put_double,
+                              .query_vscanf   = impl_base_query_vscanf,
+                              .form_vscanf    = impl_base_form_vscanf,
+                              .alloc          = impl_arena_alloc,
+                              .free           = impl_arena_free,
+                              .arena          = arena};
+
+  htmc_entry_point_t entry = load_page_entry(page);
+  if (NULL == entry || NULL == arena) {
+    return EXIT_FAILURE;
+  }
+
+  call_htmc_entry(entry, &handover);
+  htmc_arena_reset(arena);
+  return EXIT_SUCCESS;
+}
+
+void load_page_release(load_page_t *page) {
+  pthread_mutex_lock(&loadRegistryLock);
+  drop_page(page);
+  pthread_mutex_unlock(&loadRegistryLock);
+}
+
+void load_registry_clear() {
+  pthread_mutex_lock(&loadRegistryLock);
+
+  for (size_t i = 0; i < LOAD_REGISTRY_SIZE; i++) {
+    load_page_t *page = loadRegistry[i];
+    loadRegistry[i]   = NULL;
+
+    while (NULL != page) {
+      load_page_t *next = page->next;
+      drop_page(page);
+      page = next;
+    }
+  }
+
+  pthread_mutex_unlock(&loadRegistryLock);
+}
+
+htmc_route_fn_t get_htmc_route(void *bundle_handle, const char *path) {
+  log_info("reading bundle route");
+  if (!bundle_handle) {
+    log_error("bundle handle is NULL");
+    return NULL;
+  }
+
+  const htmc_route_table_t *routes =
+      dlsym(bundle_handle, HTMC_BUNDLE_ROUTES_SYM);
+
+  return bundle_find(routes, path);
+}
+
+int run_htmc_route(const char      *bundle_path,
+                   const char      *path,
+                   htmc_handover_t *handover) {
+  htmc_route_fn_t route = get_htmc_route(load_htmc_so(bundle_path), path);
+
+  log_info("calling bundle route");
+  if (NULL == route) {
+    log_error("unable to locate bundle route");
+    return EXIT_FAILURE;
+  }
+
+  route(handover);
+  return EXIT_SUCCESS;
+}
+
+static void write_profile(const void *data, unsigned len, void *arg) {
+  fwrite(data, 1, len, arg);
+}
+
+static void *alloc_profile(unsigned len, void *arg) {
+  return malloc(len);
+}
+
+int dump_htmc_profile(const char *so_file_path, const char *profile_path) {
+  log_info("writing profile");
+
+  // The counters are those of the version in the registry, which is
+  // the one that ran
+  load_page_t *page = load_page_acquire(so_file_path);
+  if (NULL == page) {
+    log_error("unable to load shared object");
+    return EXIT_FAILURE;
+  }
+
+  htmc_profile_dump_t dump_profile =
+      (htmc_profile_dump_t)dlsym(page->handle, HTMC_PROFILE_DUMP_SYM);
+
+  FILE *profile_file = NULL;
+  int   ret          = EXIT_FAILURE;
+
+  if (NULL == dump_profile) {
+    log_error("shared object was not built for profiling");
+    goto cleanup;
+  }
+
+  profile_file = fopen(profile_path, "wb");
+  if (NULL == profile_file) {
+    log_error("unable to create profile");
+    goto cleanup;
+  }
+
+  // Memory used while writing is released when the process exits
+  dump_profile(write_profile, alloc_profile, profile_file);
+
+  if (0 != fclose(profile_file)) {
+    log_error("unable to write profile");
+    goto cleanup;
+  }
+
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  load_page_release(page);
+  return ret;
 }
@@ -33,18 +33,27 @@ const char *const HTMC_STR_LOG_LEVELS[] = {"all",
                                            "off"};
 
 log_lvl_t logLevel;
-bool      logSafeMode = false;
+bool      logSafeMode    = false;
+FILE     *logCaptureFile = NULL;
 
 void log_fatal(const char *message) {
   if (HTMC_LOG_LEVEL_ERROR >= logLevel || !logSafeMode) {
     fprintf(stderr, "htmc fatal error: %s.\n", message);
   }
+
+  if (NULL != logCaptureFile) {
+    fprintf(logCaptureFile, "htmc fatal error: %s.\n", message);
+  }
 }
 
 void log_error(const char *message) {
   if (HTMC_LOG_LEVEL_ERROR >= logLevel || !logSafeMode) {
     fprintf(stderr, "htmc error:       %s.\n", message);
   }
+
+  if (NULL != logCaptureFile) {
+    fprintf(logCaptureFile, "htmc error:       %s.\n", message);
+  }
 }
 
 void log_info(const char *message) {
@@ -61,6 +70,10 @@ void log_set_safe() {
   logSafeMode = true;
 }
 
+void log_set_capture(FILE *capture_file) {
+  logCaptureFile = capture_file;
+}
+
 int log_translate_level(const char *lvl_str) {
   for (int i = 0; i < sizeof HTMC_STR_LOG_LEVELS / sizeof(char *); i++) {
     if (0 == strcmp(lvl_str, HTMC_STR_LOG_LEVELS[i])) {
@@ -26,22 +26,41 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "build.h"
 #include "cli.h"
 #include "compile.h"
-#include "fscache.h"
 #include "libhtmc/libhtmc-internals.h"
 #include "libhtmc/libhtmc.h"
 #include "load.h"
 #include "log.h"
-#include "parse.h"
 
 #define HTMC_FLAG_NO_SPLASH "-ns"
 #define HTMC_FLAG_OUTPUT    "-o"
 #define HTMC_FLAG_LOG_LVL   "-ll"
+#define HTMC_FLAG_SPEC_PF   "-sp"
+#define HTMC_FLAG_MINIFY    "-m"
+#define HTMC_FLAG_JOBS      "-j"
+#define HTMC_FLAG_SHARED_RT "-sr"
+#define HTMC_FLAG_STORE     "-as"
+#define HTMC_FLAG_TIERED    "-tc"
+#define HTMC_FLAG_PROFILE   "-pg"
+#define HTMC_FLAG_BUNDLE    "-bn"
+#define HTMC_FLAG_WARM_UP   "-wu"
+#define HTMC_FLAG_MEM_LIMIT "-ml"
 
 #define HTMC_FLAG_FULL_NO_SPLASH "--no-splash"
 #define HTMC_FLAG_FULL_OUTPUT    "--output-path"
 #define HTMC_FLAG_FULL_LOG_LVL   "--log-level"
+#define HTMC_FLAG_FULL_SPEC_PF   "--specialize-printf"
+#define HTMC_FLAG_FULL_MINIFY    "--minify"
+#define HTMC_FLAG_FULL_JOBS      "--jobs"
+#define HTMC_FLAG_FULL_SHARED_RT "--shared-runtime"
+#define HTMC_FLAG_FULL_STORE     "--artifact-store"
+#define HTMC_FLAG_FULL_TIERED    "--tiered-compilation"
+#define HTMC_FLAG_FULL_PROFILE   "--profile"
+#define HTMC_FLAG_FULL_BUNDLE    "--bundle"
+#define HTMC_FLAG_FULL_WARM_UP   "--warm-up"
+#define HTMC_FLAG_FULL_MEM_LIMIT "--memory-limit"
 
 #define HTMC_CLI_HELP      "-h"
 #define HTMC_CLI_LICENSE   "-l"
@@ -49,6 +68,7 @@
 #define HTMC_CLI_TRANSLATE "-t"
 #define HTMC_CLI_COMPILE   "-c"
 #define HTMC_CLI_BUILD     "-b"
+#define HTMC_CLI_PRELOAD   "-p"
 #define HTMC_CLI_LOAD_SO   "-s"
 #define HTMC_CLI_RUN       "-r"
 
@@ -58,6 +78,7 @@
 #define HTMC_CLI_FULL_TRANSLATE "--translate"
 #define HTMC_CLI_FULL_COMPILE   "--compile"
 #define HTMC_CLI_FULL_BUILD     "--build"
+#define HTMC_CLI_FULL_PRELOAD   "--preload"
 #define HTMC_CLI_FULL_LOAD_SO   "--load-shared"
 #define HTMC_CLI_FULL_RUN       "--run"
 
@@ -81,7 +102,8 @@ cli_opt_desc_t matches[] = {
 
     {HTMC_CLI_TRANSLATE, HTMC_CLI_FULL_TRANSLATE, NULL, false, cli_translate},
     {HTMC_CLI_COMPILE, HTMC_CLI_FULL_COMPILE, NULL, false, cli_compile},
-    // {HTMC_CLI_BUILD, HTMC_CLI_FULL_BUILD, NULL, false, NULL},
+    {HTMC_CLI_BUILD, HTMC_CLI_FULL_BUILD, NULL, false, cli_build},
+    {HTMC_CLI_PRELOAD, HTMC_CLI_FULL_PRELOAD, NULL, false, cli_preload},
     {HTMC_CLI_LOAD_SO, HTMC_CLI_FULL_LOAD_SO, NULL, false, cli_load_shared},
     // {HTMC_CLI_RUN, HTMC_CLI_FULL_RUN, NULL, false, cli_run},
 
@@ -94,6 +116,33 @@ cli_opt_desc_t matches[] = {
 
     {HTMC_FLAG_OUTPUT, HTMC_FLAG_FULL_OUTPUT, flag_output, true, NULL},
     {HTMC_FLAG_LOG_LVL, HTMC_FLAG_FULL_LOG_LVL, flag_log_level, true, NULL},
+
+    {HTMC_FLAG_SPEC_PF,
+     HTMC_FLAG_FULL_SPEC_PF,
+     flag_specialize_printf,
+     false,
+     NULL},
+
+    {HTMC_FLAG_MINIFY, HTMC_FLAG_FULL_MINIFY, flag_minify, false, NULL},
+    {HTMC_FLAG_JOBS, HTMC_FLAG_FULL_JOBS, flag_jobs, true, NULL},
+
+    {HTMC_FLAG_SHARED_RT,
+     HTMC_FLAG_FULL_SHARED_RT,
+     flag_shared_runtime,
+     false,
+     NULL},
+
+    {HTMC_FLAG_STORE, HTMC_FLAG_FULL_STORE, flag_artifact_store, true, NULL},
+    {HTMC_FLAG_TIERED, HTMC_FLAG_FULL_TIERED, flag_tiered, false, NULL},
+    {HTMC_FLAG_PROFILE, HTMC_FLAG_FULL_PROFILE, flag_profile, true, NULL},
+    {HTMC_FLAG_BUNDLE, HTMC_FLAG_FULL_BUNDLE, flag_bundle, true, NULL},
+    {HTMC_FLAG_WARM_UP, HTMC_FLAG_FULL_WARM_UP, flag_warm_up, false, NULL},
+
+    {HTMC_FLAG_MEM_LIMIT,
+     HTMC_FLAG_FULL_MEM_LIMIT,
+     flag_memory_limit,
+     true,
+     NULL},
 };
 
 int cgi_main() {
@@ -122,47 +171,23 @@ int cgi_main() {
     tmp_dir = "./tmp";
   }
 
-  char *fn_templ = malloc(strlen(path) + 1);
-
-  for (int i = 0; path[i]; i++) {
-    if ('/' == path[i] || '\\' == path[i]) {
-      fn_templ[i] = '_';
-      continue;
-    }
-
-    fn_templ[i] = path[i];
-  }
-
-  char *c_file_path  = malloc(strlen(tmp_dir) + 1 + strlen(fn_templ) + 3);
-  char *so_file_path = malloc(strlen(tmp_dir) + 1 + strlen(fn_templ) + 4);
+  // Bundles are served as they were built, pages are not checked
+  build_paths_t paths   = {0};
+  bool          bundled = NULL != cliInfo.bundle_path;
 
-  sprintf(c_file_path, "%s/%s.c", tmp_dir, fn_templ);
-  sprintf(so_file_path, "%s/%s.so", tmp_dir, fn_templ);
-
-  if (0 <= fscache_cmp_pp(path, c_file_path)) {
-    FILE *src_file = fopen(path, "r");
-
-    if (NULL == src_file) {
-      log_fatal("no such file or directory");
-      return EXIT_FAILURE;
-    }
-
-    FILE *c_file = fopen(c_file_path, "w");
-
-    if (EXIT_SUCCESS != parse_and_emit(src_file, c_file)) {
-      log_fatal("error while parsing source file");
-      return EXIT_FAILURE;
-    }
-
-    fclose(c_file);
+  if (!bundled && !build_paths_init(&paths, tmp_dir, path)) {
+    return EXIT_FAILURE;
   }
 
-  if (0 <= fscache_cmp_pp(c_file_path, so_file_path) &&
-      EXIT_SUCCESS != compile_c_output(c_file_path, so_file_path)) {
-    log_fatal("error while producing shared object");
+  if (!bundled && EXIT_SUCCESS != build_page(&paths)) {
+    printf("Status: 500 Internal Server Error\n\n");
+    build_paths_free(&paths);
     return EXIT_FAILURE;
   }
 
+  // Pages allocate from the arena of the process, which serves a single
+  // request in CGI mode
+  htmc_arena_t   *arena    = htmc_arena_create(cliInfo.memory_limit);
   htmc_handover_t handover = {.variant_id     = HTMC_BASE_HANDOVER,
                               .request_method = method,
                               .query_string   = query_string,
@@ -171,13 +196,34 @@ int cgi_main() {
                               .request_body   = "",
                               .vprintf        = impl_debug_vprintf,
                               .puts           = impl_debug_puts,
+                              .write          = impl_debug_write,
+                              .put_int        = impl_base_put_int,
+                              .put_uint       = impl_base_put_uint,
+                              .put_double     = impl_base_put_double,
                               .query_vscanf   = impl_base_query_vscanf,
                               .form_vscanf    = impl_base_form_vscanf,
-                              .alloc          = impl_debug_alloc,
-                              .free           = impl_debug_free};
+                              .alloc          = impl_arena_alloc,
+                              .free           = impl_arena_free,
+                              .arena          = arena};
+
+  if (NULL == arena || EXIT_SUCCESS != prepare_shared_runtime(cliInfo)) {
+    htmc_arena_destroy(arena);
+    build_paths_free(&paths);
+    return EXIT_FAILURE;
+  }
 
   printf("Content-type: text/html\n\n");
-  return run_htmc_so(so_file_path, &handover);
+  int ret = bundled ? run_htmc_route(cliInfo.bundle_path, path, &handover)
+                    : run_htmc_so(paths.so_file_path, &handover);
+
+  // Requests served while profiling are the training runs
+  if (!bundled && (compile_get_options() & COMPILE_OPT_PROFILE_GENERATE)) {
+    build_record_profile(&paths);
+  }
+
+  htmc_arena_destroy(arena);
+  build_paths_free(&paths);
+  return ret;
 }
 
 int main(int argc, char *argv[]) {
@@ -191,7 +237,7 @@ int main(int argc, char *argv[]) {
     bool        found_matching_option = false;
     const char *argument              = argv[i];
     const char *next                  = NULL;
-    if (argc - i != i) {
+    if (i + 1 < argc) {
       next = argv[i + 1];
     }
 
@@ -0,0 +1,193 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+
+#include "minify.h"
+
+#define MINIFY_COMMENT_START "<!--"
+#define MINIFY_COMMENT_END   "-->"
+
+#define IS_SPACE(c)    isspace((unsigned char)c)
+#define IS_TAG_CHAR(c) isalnum((unsigned char)c)
+
+// Elements whose contents are whitespace-sensitive or not HTML
+static const char *MINIFY_RAW_TAGS[] = {"pre", "textarea", "script", "style"};
+
+static bool is_raw_tag(const char *tag) {
+  for (size_t i = 0; i < sizeof MINIFY_RAW_TAGS / sizeof(char *); i++) {
+    if (0 == strcasecmp(MINIFY_RAW_TAGS[i], tag)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool starts_with(const char *run, size_t len, size_t i, const char *s) {
+  size_t s_len = strlen(s);
+  return len - i >= s_len && 0 == memcmp(run + i, s, s_len);
+}
+
+// Reads the name of the tag starting at run[i] (after '<')
+static size_t read_tag_name(const char *run, size_t len, size_t i, char *tag) {
+  size_t tag_len = 0;
+
+  while (i < len && IS_TAG_CHAR(run[i]) && tag_len < MINIFY_MAX_TAG) {
+    tag[tag_len++] = run[i++];
+  }
+
+  tag[tag_len] = 0;
+  return i;
+}
+
+// Returns the index of the end of the comment starting at i or 0 if the
+// comment does not end in this run
+static size_t find_comment_end(const char *run, size_t len, size_t i) {
+  for (i += strlen(MINIFY_COMMENT_START); i < len; i++) {
+    if (starts_with(run, len, i, MINIFY_COMMENT_END)) {
+      return i + strlen(MINIFY_COMMENT_END);
+    }
+  }
+
+  return 0;
+}
+
+// Returns true if run[i] starts the closing tag of the current raw element
+static bool is_raw_end(const minify_state_t *state,
+                       const char           *run,
+                       size_t                len,
+                       size_t                i) {
+  size_t tag_len = strlen(state->tag);
+
+  if (!starts_with(run, len, i, "</") || len - i - 2 < tag_len ||
+      0 != strncasecmp(run + i + 2, state->tag, tag_len)) {
+    return false;
+  }
+
+  return len - i - 2 == tag_len || !IS_TAG_CHAR(run[i + 2 + tag_len]);
+}
+
+size_t minify_run(minify_state_t *state, char *run, size_t len) {
+  size_t out = 0;
+  size_t i   = 0;
+
+  // Output never grows, so the run is rewritten in place
+  while (i < len) {
+    char c = run[i];
+
+    switch (state->mode) {
+    case MINIFY_TAG:
+      run[out++] = run[i++];
+      if (0 != state->quote) {
+        state->quote = (state->quote == c) ? 0 : state->quote;
+      } else if ('"' == c || '\'' == c) {
+        state->quote = c;
+      } else if ('>' == c) {
+        state->mode = state->opens_raw ? MINIFY_RAW : MINIFY_TEXT;
+      }
+      continue;
+
+    case MINIFY_RAW:
+      if (is_raw_end(state, run, len, i)) {
+        state->mode      = MINIFY_TAG;
+        state->opens_raw = false;
+      }
+
+      run[out++] = run[i++];
+      continue;
+
+    case MINIFY_COMMENT:
+      if (starts_with(run, len, i, MINIFY_COMMENT_END)) {
+        state->mode = MINIFY_TEXT;
+        memmove(run + out, run + i, strlen(MINIFY_COMMENT_END));
+        out += strlen(MINIFY_COMMENT_END);
+        i += strlen(MINIFY_COMMENT_END);
+        continue;
+      }
+
+      run[out++] = run[i++];
+      continue;
+
+    case MINIFY_TEXT:
+      break;
+    }
+
+    if (IS_SPACE(c)) {
+      char space = ' ';
+
+      for (; i < len && IS_SPACE(run[i]); i++) {
+        space = ('\n' == run[i]) ? '\n' : space;
+      }
+
+      // Whitespace around a removed comment is merged as well
+      if (0 < out && IS_SPACE(run[out - 1])) {
+        run[out - 1] = ('\n' == space) ? space : run[out - 1];
+        continue;
+      }
+
+      run[out++] = space;
+      continue;
+    }
+
+    if ('<' != c) {
+      run[out++] = run[i++];
+      continue;
+    }
+
+    // Conditional comments are interpreted by some browsers
+    if (starts_with(run, len, i, MINIFY_COMMENT_START) &&
+        !starts_with(run, len, i, MINIFY_COMMENT_START "[")) {
+      size_t end = find_comment_end(run, len, i);
+
+      if (0 != end) {
+        i = end;
+        continue;
+      }
+
+      // The comment is split by a code block whose output would end up
+      // in it, so it is kept as is
+      state->mode = MINIFY_COMMENT;
+      memmove(run + out, run + i, strlen(MINIFY_COMMENT_START));
+      out += strlen(MINIFY_COMMENT_START);
+      i += strlen(MINIFY_COMMENT_START);
+      continue;
+    }
+
+    if (i + 1 < len && (IS_TAG_CHAR(run[i + 1]) || '/' == run[i + 1] ||
+                        '!' == run[i + 1])) {
+      size_t name_end = read_tag_name(run, len, i + 1, state->tag);
+
+      state->mode      = MINIFY_TAG;
+      state->quote     = 0;
+      state->opens_raw = name_end > i + 1 && is_raw_tag(state->tag);
+    }
+
+    run[out++] = run[i++];
+  }
+
+  return out;
+}
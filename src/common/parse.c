@@ -24,29 +24,33 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "emit.h"
+#include "fmtspec.h"
+#include "fsmap.h"
 #include "log.h"
+#include "minify.h"
 #include "parse.h"
 
 #define C_STR_CHAR          '"'
+#define C_CHAR_CHAR         '\''
 #define C_ESCAPE_CHAR       '\\'
 #define C_LSCOPE_CHAR       '{'
 #define C_RSCOPE_CHAR       '}'
-#define C_DELIM             ';'
 #define C_LINE_COMMENT_CHAR '/'
 #define C_ML_COMMENT_CHAR2  '*'
 
 #define COMMON_EOL_CHAR '\n'
 #define COMMON_TAB_CHAR '\t'
 
-#define IS_STR_DELIM(c)       C_STR_CHAR == c
-#define IS_ESCAPE(c)          C_ESCAPE_CHAR == c
-#define IS_SCOPE(c)           C_LSCOPE_CHAR == c
-#define IS_EOS(c)             C_RSCOPE_CHAR == c
-#define IS_DELIM(c)           C_DELIM == c
-#define IS_EOL(c)             COMMON_EOL_CHAR == c
-#define IS_TAB(c)             COMMON_TAB_CHAR == c
+#define IS_STR_DELIM(c)       (C_STR_CHAR == c)
+#define IS_CHAR_DELIM(c)      (C_CHAR_CHAR == c)
+#define IS_ESCAPE(c)          (C_ESCAPE_CHAR == c)
+#define IS_SCOPE(c)           (C_LSCOPE_CHAR == c)
+#define IS_EOS(c)             (C_RSCOPE_CHAR == c)
+#define IS_EOL(c)             (COMMON_EOL_CHAR == c)
+#define IS_TAB(c)             (COMMON_TAB_CHAR == c)
 #define IS_LINE_COMMENT(l, c) (C_LINE_COMMENT_CHAR == c && c == l)
 #define IS_ML_COMMENT(l, c) \
   (C_LINE_COMMENT_CHAR == l && C_ML_COMMENT_CHAR2 == c)
@@ -54,183 +58,737 @@
   (C_ML_COMMENT_CHAR2 == l && C_LINE_COMMENT_CHAR == c)
 
 #define IS_TAG_HTMC(c)  ('c' == c)
+#define IS_TAG_EXPR(c)  ('=' == c)
 #define IS_TAG_CLOSE(c) ('>' == c)
 #define IS_TAG_FIT(c)   ('?' == c)
 
+#define TAG_INCLUDE      "include"
+#define TAG_INCLUDE_LEN  (sizeof TAG_INCLUDE - 1)
+#define TAG_ARG_QUOTE    '"'
+#define TAG_PROFILE      "profile"
+#define TAG_PROFILE_LEN  (sizeof TAG_PROFILE - 1)
+
+#define PARSE_MAX_PATH          4096
+#define PARSE_MAX_INCLUDE_DEPTH 16
+
+typedef enum {
+  PARSE_TAG_HTMC,
+  PARSE_TAG_EXPR,
+  PARSE_TAG_INCLUDE,
+  PARSE_TAG_PROFILE,
+} parse_tag_t;
+
 typedef struct {
-  uint64_t lineno;
-  uint64_t chr_index;
-  uint64_t scope_sum;
-  bool     html_init;
+  parse_tag_t    tag;
+  uint64_t       lineno;
+  uint64_t       chr_index;
+  uint64_t       scope_sum;
+  emit_blob_t    blob;
+  minify_state_t minify;
+  const char       *src_path;
+  FILE             *deps_file;
+  parse_input_fcn_t input_fcn;
+  void             *input_arg;
+  int               include_depth;
+  char             *profile;
+  bool              has_profile;
 } parse_status_t;
 
+int parse_source(FILE *src_file, FILE *dst_file, parse_status_t *parse_status);
+
+int parseOptions = 0;
+
+void parse_set_option(parse_opt_t opt) {
+  parseOptions |= opt;
+}
+
+int parse_get_options() {
+  return parseOptions;
+}
+
 inline void reset_parse_status(parse_status_t *parse_status) {
   parse_status->lineno++;
   parse_status->chr_index = 0;
 }
 
-bool find_tag_and_emit(FILE           *src_file,
-                       FILE           *dst_file,
-                       parse_status_t *parse_status) {
-  if (!parse_status->html_init) {
-    emit_html_base(dst_file);
-    parse_status->html_init = true;
+// Emits the static markup collected since run_start as a blob segment
+void emit_run_segment(FILE           *dst_file,
+                      parse_status_t *parse_status,
+                      size_t          run_start) {
+  emit_blob_t *blob = &parse_status->blob;
+
+  if ((parseOptions & PARSE_OPT_MINIFY) && !blob->failed) {
+    blob->len = run_start + minify_run(&parse_status->minify,
+                                       blob->buf + run_start,
+                                       blob->len - run_start);
   }
 
-  bool found;
-  char c;
+  if (blob->len > run_start) {
+    emit_html_segment(dst_file, run_start, blob->len - run_start);
+  }
+}
 
-  emit_html_block(dst_file);
-  while ((found = !feof(src_file)) && '<' != (c = fgetc(src_file))) {
-    emit_char_escaped(dst_file, c);
-    if (IS_EOL(c)) {
-      reset_parse_status(parse_status);
-    }
+// Expression tags are wrapped in a call to the typed writers
+void emit_tag_base(FILE *dst_file, parse_tag_t tag) {
+  if (PARSE_TAG_EXPR == tag) {
+    emit_expr_base(dst_file);
   }
+}
 
-  emit_html_block_end(dst_file);
-  return found;
+void emit_tag_end(FILE *dst_file, parse_tag_t tag) {
+  if (PARSE_TAG_EXPR == tag) {
+    emit_expr_end(dst_file);
+  }
 }
 
-bool is_tag_fit(FILE *src_file, char *cp) {
-  if (feof(src_file)) {
-    return false;
+// Section
+// Directives
+
+// Directive tags are a keyword followed by a quoted argument
+const char *directive_keyword(int c, parse_tag_t *tag) {
+  if (TAG_PROFILE[0] == c) {
+    *tag = PARSE_TAG_PROFILE;
+    return TAG_PROFILE;
+  }
+
+  *tag = PARSE_TAG_INCLUDE;
+  return TAG_INCLUDE;
+}
+
+// The compiler profile applies to the whole page, wherever it is set
+int set_profile(parse_status_t *parse_status, const char *name) {
+  if (parse_status->has_profile) {
+    log_error("multiple profile tags");
+    return -1;
+  }
+
+  if (PARSE_MAX_PROFILE <= strlen(name)) {
+    log_error("profile name too long");
+    return -1;
   }
 
-  return IS_TAG_FIT((*cp = fgetc(src_file)));
+  parse_status->has_profile = true;
+  if (NULL != parse_status->profile) {
+    strcpy(parse_status->profile, name);
+  }
+
+  return 0;
 }
 
-bool is_tag_htmc(FILE *src_file, char *cp) {
-  if (feof(src_file)) {
+// Section
+// Includes
+
+// Include paths are relative to the including file
+bool resolve_include_path(char           *dst,
+                          const char     *inc_path,
+                          parse_status_t *parse_status) {
+  const char *src_path = parse_status->src_path;
+  size_t      dir_len  = 0;
+
+  if (NULL != src_path && '/' != inc_path[0]) {
+    const char *slash = strrchr(src_path, '/');
+    dir_len           = (NULL != slash) ? slash - src_path + 1 : 0;
+  }
+
+  if (dir_len + strlen(inc_path) + 1 > PARSE_MAX_PATH) {
     return false;
   }
 
-  return IS_TAG_HTMC((*cp = fgetc(src_file)));
+  memcpy(dst, src_path, dir_len);
+  strcpy(dst + dir_len, inc_path);
+  return true;
 }
 
-bool collect_emit_c(FILE           *src_file,
-                    FILE           *dst_file,
-                    parse_status_t *parse_status) {
-  bool escape       = false;
-  bool string       = false;
-  bool terminated   = false;
-  bool line_comment = false;
-  bool ml_comment   = false;
-  bool comment      = line_comment || ml_comment;
-  char last         = 0;
-  char c            = 0;
-
-  while ((c = fgetc(src_file))) {
-    if (!string && IS_LINE_COMMENT(last, c)) {
-      line_comment = true;
-      goto emit;
-    }
+int include_and_emit(FILE           *dst_file,
+                     parse_status_t *parse_status,
+                     const char     *inc_path) {
+  char path[PARSE_MAX_PATH];
 
-    if (!string && IS_ML_COMMENT(last, c)) {
-      ml_comment = true;
-      goto emit;
-    }
+  if (PARSE_MAX_INCLUDE_DEPTH <= parse_status->include_depth) {
+    log_error("too many nested includes");
+    return -1;
+  }
 
-    if (IS_EOL(c)) {
-      string       = false;
-      line_comment = false;
-      reset_parse_status(parse_status);
-      goto emit;
+  if (!resolve_include_path(path, inc_path, parse_status)) {
+    log_error("include path too long");
+    return -1;
+  }
+
+  // Missing files are listed as well, a failed translation depends on
+  // them too
+  if (NULL != parse_status->deps_file) {
+    fprintf(parse_status->deps_file, "%s\n", path);
+  }
+
+  FILE *inc_file = fopen(path, "r");
+  if (NULL == inc_file) {
+    if (NULL != parse_status->input_fcn) {
+      parse_status->input_fcn(path, NULL, NULL, 0, parse_status->input_arg);
     }
 
+    log_error("included file not found");
+    return -1;
+  }
+
+  const char    *src_path = parse_status->src_path;
+  const uint64_t lineno   = parse_status->lineno;
+
+  parse_status->src_path = path;
+  parse_status->lineno   = 0;
+  parse_status->include_depth++;
+
+  int ret = parse_source(inc_file, dst_file, parse_status);
+
+  parse_status->include_depth--;
+  parse_status->src_path = src_path;
+  parse_status->lineno   = lineno;
+
+  fclose(inc_file);
+  return ret;
+}
+
+// Section
+// Code blocks
+// Both front ends feed code blocks to the same scanner one char at a
+// time, so that they accept the same syntax
+
+typedef enum {
+  C_SCAN_MORE,
+  C_SCAN_CLOSE,
+  C_SCAN_ERROR,
+} c_scan_result_t;
+
+typedef struct {
+  bool string;
+  bool character;
+  bool escape;
+  bool line_comment;
+  bool ml_comment;
+  char last;
+} c_scan_t;
+
+// Returns C_SCAN_CLOSE after the '>' of the closing tag, "?>" only
+// closes the block outside of strings, char literals and block comments
+// Like in PHP, line comments end at the closing tag
+c_scan_result_t c_scan_char(c_scan_t       *scan,
+                            char            c,
+                            parse_status_t *parse_status) {
+  const char last = scan->last;
+  scan->last      = c;
+
+  if (IS_EOL(c)) {
+    reset_parse_status(parse_status);
+  }
+
+  if (scan->escape) {
+    scan->escape = false;
+    return C_SCAN_MORE;
+  }
+
+  if (IS_EOL(c)) {
+    scan->line_comment = false;
+    return C_SCAN_MORE;
+  }
+
+  if (scan->line_comment) {
+    return (IS_TAG_FIT(last) && IS_TAG_CLOSE(c)) ? C_SCAN_CLOSE : C_SCAN_MORE;
+  }
+
+  // The chars of "/*" and "*/" do not start other pairs
+  if (scan->ml_comment) {
     if (IS_ML_COMMNENT_END(last, c)) {
-      ml_comment = false;
-      goto emit;
+      scan->ml_comment = false;
+      scan->last       = 0;
     }
 
-    // If there's a backslash in a string
-    if (string && !escape && IS_ESCAPE(c)) {
-      escape = true;
-      goto emit;
+    return C_SCAN_MORE;
+  }
+
+  if (scan->string || scan->character) {
+    if (IS_ESCAPE(c)) {
+      scan->escape = true;
+    } else if (scan->string && IS_STR_DELIM(c)) {
+      scan->string = false;
+    } else if (scan->character && IS_CHAR_DELIM(c)) {
+      scan->character = false;
     }
 
-    // If there is a quote sign inside a string
-    // preceded by an escpae backslash
-    if (string && escape && IS_STR_DELIM(c)) {
-      escape = false;
-      goto emit;
+    return C_SCAN_MORE;
+  }
+
+  if (IS_LINE_COMMENT(last, c)) {
+    scan->line_comment = true;
+    return C_SCAN_MORE;
+  }
+
+  if (IS_ML_COMMENT(last, c)) {
+    scan->ml_comment = true;
+    scan->last       = 0;
+    return C_SCAN_MORE;
+  }
+
+  scan->string    = IS_STR_DELIM(c);
+  scan->character = IS_CHAR_DELIM(c);
+
+  if (IS_TAG_FIT(last) && IS_TAG_CLOSE(c)) {
+    return C_SCAN_CLOSE;
+  }
+
+  // Error if code contains end of main scope
+  if (IS_EOS(c) && 0 == parse_status->scope_sum) {
+    return C_SCAN_ERROR;
+  }
+
+  parse_status->scope_sum += IS_SCOPE(c);
+  parse_status->scope_sum -= IS_EOS(c);
+  return C_SCAN_MORE;
+}
+
+void emit_c_code(FILE *dst_file, const char *code, size_t len) {
+  if (parseOptions & PARSE_OPT_SPECIALIZE_PRINTF) {
+    fmtspec_emit_c(dst_file, code, len);
+    return;
+  }
+
+  emit_buf(dst_file, code, len);
+}
+
+// Section
+// Stream front end
+// Used when the source cannot be mapped (e.g., pipes)
+
+// These functions consume the next char only if it matches
+// Otherwise, the char is pushed back to be treated as markup
+bool is_tag_fit(FILE *src_file) {
+  int c = fgetc(src_file);
+
+  if (IS_TAG_FIT(c)) {
+    return true;
+  }
+
+  ungetc(c, src_file);
+  return false;
+}
+
+bool is_tag_htmc(FILE *src_file, parse_status_t *parse_status) {
+  int c = fgetc(src_file);
+
+  if (IS_TAG_HTMC(c)) {
+    parse_status->tag = PARSE_TAG_HTMC;
+    return true;
+  }
+
+  if (IS_TAG_EXPR(c)) {
+    parse_status->tag = PARSE_TAG_EXPR;
+    return true;
+  }
+
+  // The chars read to match a directive keyword are markup
+  // if it does not match
+  parse_tag_t  tag;
+  const char  *keyword     = directive_keyword(c, &tag);
+  const size_t keyword_len = strlen(keyword);
+  size_t       matched     = 0;
+
+  while (matched < keyword_len && keyword[matched] == c) {
+    c = fgetc(src_file);
+    matched++;
+  }
+
+  if (keyword_len == matched && isspace(c)) {
+    parse_status->tag = tag;
+    return true;
+  }
+
+  emit_blob_append(&parse_status->blob, "<?", 2);
+  emit_blob_append(&parse_status->blob, keyword, matched);
+  ungetc(c, src_file);
+  return false;
+}
+
+bool find_tag_and_emit(FILE           *src_file,
+                       FILE           *dst_file,
+                       parse_status_t *parse_status) {
+  const size_t run_start = parse_status->blob.len;
+  bool         found     = false;
+  int          c;
+
+  while (EOF != (c = fgetc(src_file))) {
+    if ('<' == c && is_tag_fit(src_file)) {
+      if (is_tag_htmc(src_file, parse_status)) {
+        found = true;
+        break;
+      }
+
+      continue;
     }
 
-    // If char is " string might begin or end
-    if (!escape && !comment && IS_STR_DELIM(c)) {
-      string = !string;
-      goto emit;
+    emit_blob_append_char(&parse_status->blob, c);
+    if (IS_EOL(c)) {
+      reset_parse_status(parse_status);
     }
+  }
 
-    // Error if code contains end of main scope
-    if (!string && IS_EOS(c) && 0 == parse_status->scope_sum) {
+  emit_run_segment(dst_file, parse_status, run_start);
+  return found;
+}
+
+// The block is collected and emitted at once, like in the buffer
+// front end, so that both emit the same code
+bool collect_emit_c(FILE           *src_file,
+                    FILE           *dst_file,
+                    parse_status_t *parse_status) {
+  c_scan_t        scan   = {0};
+  c_scan_result_t result = C_SCAN_MORE;
+  emit_blob_t     code   = {0};
+  int             c;
+
+  while (C_SCAN_MORE == result && EOF != (c = fgetc(src_file))) {
+    result = c_scan_char(&scan, c, parse_status);
+    emit_blob_append_char(&code, c);
+  }
+
+  // The "?>" is not part of the code, the '?' was collected
+  bool ok = C_SCAN_CLOSE == result && !code.failed;
+  if (ok) {
+    emit_c_code(dst_file, code.buf, code.len - 2);
+  }
+
+  emit_blob_free(&code);
+  return ok;
+}
+
+// Closes the entry point and emits the static blob after it
+// The blob is released in any case
+int finish_and_emit(FILE *dst_file, parse_status_t *parse_status, int ret) {
+  if (0 == ret && parse_status->blob.failed) {
+    log_fatal("out of memory");
+    ret = -1;
+  }
+
+  if (0 == ret) {
+    emit_end(dst_file);
+    emit_html_blob(dst_file, &parse_status->blob);
+  }
+
+  emit_blob_free(&parse_status->blob);
+  return ret;
+}
+
+// Reads the quoted argument of a directive tag and the closing tag
+bool collect_quoted(FILE *src_file, char *arg) {
+  int    c;
+  size_t len = 0;
+
+  while (isspace(c = fgetc(src_file))) {
+  }
+
+  if (TAG_ARG_QUOTE != c) {
+    return false;
+  }
+
+  while (EOF != (c = fgetc(src_file)) && TAG_ARG_QUOTE != c &&
+         !IS_EOL(c)) {
+    if (PARSE_MAX_PATH - 1 == len) {
       return false;
     }
 
-    // If char is ';'
-    if (!string && !comment && IS_DELIM(c)) {
-      terminated = true;
-      goto emit;
+    arg[len++] = c;
+  }
+
+  arg[len] = 0;
+  if (TAG_ARG_QUOTE != c || 0 == len) {
+    return false;
+  }
+
+  while (isspace(c = fgetc(src_file))) {
+  }
+
+  return IS_TAG_FIT(c) && IS_TAG_CLOSE(fgetc(src_file));
+}
+
+int parse_stream(FILE *src_file, FILE *dst_file, parse_status_t *parse_status) {
+  int ret = 0;
+
+  while (0 == ret && find_tag_and_emit(src_file, dst_file, parse_status)) {
+    if (PARSE_TAG_INCLUDE == parse_status->tag ||
+        PARSE_TAG_PROFILE == parse_status->tag) {
+      char arg[PARSE_MAX_PATH];
+
+      if (!collect_quoted(src_file, arg)) {
+        log_error("malformed directive tag");
+        ret = -1;
+        continue;
+      }
+
+      ret = (PARSE_TAG_INCLUDE == parse_status->tag)
+                ? include_and_emit(dst_file, parse_status, arg)
+                : set_profile(parse_status, arg);
+      continue;
     }
 
-    // Update terminated status otherwise
-    // terminated = terminated && (c < 33 || IS_TAG_HTMC(c));
+    emit_tag_base(dst_file, parse_status->tag);
 
-    // if the code has been correctly terminated
-    if (terminated && IS_TAG_FIT(last) && IS_TAG_CLOSE(c)) {
-      return true;
+    if (!collect_emit_c(src_file, dst_file, parse_status)) {
+      ret = -1;
     }
 
-    // Update scope sum
-    parse_status->scope_sum += IS_SCOPE(c);
-    parse_status->scope_sum -= IS_EOS(c);
+    emit_char(dst_file, COMMON_EOL_CHAR);
+    emit_tag_end(dst_file, parse_status->tag);
+  }
+
+  return ret;
+}
+
+// Section
+// Buffer front end
+// Used when the whole source is available in memory (e.g., mapped files)
 
-    escape = false;
-    string = IS_STR_DELIM(c);
+bool is_tag_htmc_at(const char     *src,
+                    size_t          len,
+                    size_t          off,
+                    parse_status_t *parse_status) {
+  if (off + 2 >= len || !IS_TAG_FIT(src[off + 1])) {
+    return false;
+  }
+
+  if (IS_TAG_HTMC(src[off + 2])) {
+    parse_status->tag = PARSE_TAG_HTMC;
+    return true;
+  }
+
+  if (IS_TAG_EXPR(src[off + 2])) {
+    parse_status->tag = PARSE_TAG_EXPR;
+    return true;
+  }
+
+  parse_tag_t  tag;
+  const char  *keyword     = directive_keyword(src[off + 2], &tag);
+  const size_t keyword_len = strlen(keyword);
+  const size_t kw_end      = off + 2 + keyword_len;
+
+  if (kw_end < len && 0 == memcmp(src + off + 2, keyword, keyword_len) &&
+      isspace((unsigned char)src[kw_end])) {
+    parse_status->tag = tag;
+    return true;
+  }
+
+  return false;
+}
+
+void count_lines(const char *src, size_t len, parse_status_t *parse_status) {
+  const char *end = src + len;
+
+  while (NULL != (src = memchr(src, COMMON_EOL_CHAR, end - src))) {
+    reset_parse_status(parse_status);
+    src++;
+  }
+}
 
-    if (IS_TAG_FIT(last)) {
-      emit_char(dst_file, last);
+bool find_tag_and_emit_buffer(const char     *src,
+                              size_t          len,
+                              size_t         *off,
+                              FILE           *dst_file,
+                              parse_status_t *parse_status) {
+  const size_t run_start = *off;
+  size_t       run_end   = len;
+
+  // memchr is vectorized by the C library, so static runs are
+  // skipped many bytes at a time rather than char by char
+  for (const char *tag = src + run_start;
+       NULL != (tag = memchr(tag, '<', len - (tag - src)));
+       tag++) {
+    if (is_tag_htmc_at(src, len, tag - src, parse_status)) {
+      run_end = tag - src;
+      break;
     }
-    if (!IS_TAG_FIT(c)) {
-    emit:
-      emit_char(dst_file, c);
+  }
+
+  if (run_end > run_start) {
+    const size_t seg_start = parse_status->blob.len;
+
+    emit_blob_append(&parse_status->blob, src + run_start, run_end - run_start);
+    emit_run_segment(dst_file, parse_status, seg_start);
+    count_lines(src + run_start, run_end - run_start, parse_status);
+  }
+
+  *off = run_end;
+  return run_end < len;
+}
+
+bool collect_emit_c_buffer(const char     *src,
+                           size_t          len,
+                           size_t         *off,
+                           FILE           *dst_file,
+                           parse_status_t *parse_status) {
+  c_scan_t scan = {0};
+
+  for (size_t i = *off; i < len; i++) {
+    c_scan_result_t result = c_scan_char(&scan, src[i], parse_status);
+
+    if (C_SCAN_ERROR == result) {
+      return false;
+    }
+
+    // The whole block is written at once when its end is found
+    if (C_SCAN_CLOSE == result) {
+      emit_c_code(dst_file, src + *off, i - 1 - *off);
+      *off = i + 1;
+      return true;
     }
-    // Update comment status
-    comment = line_comment || ml_comment;
-    last    = c;
   }
 
+  // Unterminated code block
   return false;
 }
 
-int parse_and_emit(FILE *src_file, FILE *dst_file) {
-  parse_status_t parse_status = {0};
+// Reads the quoted argument of a directive tag and the closing tag
+bool collect_quoted_buffer(const char *src,
+                           size_t      len,
+                           size_t     *off,
+                           char       *arg) {
+  size_t i = *off;
 
-  emit_base(dst_file);
-  while (find_tag_and_emit(src_file, dst_file, &parse_status)) {
-    char buf[2] = {0, 0};
-    if (!is_tag_fit(src_file, &buf[0]) || !is_tag_htmc(src_file, &buf[1])) {
-      emit_html_block(dst_file);
-      emit_char_escaped(dst_file, '<');
-      emit_char_escaped(dst_file, buf[0]);
-      emit_char_escaped(dst_file, buf[1]);
-      emit_html_block_end(dst_file);
+  while (i < len && isspace((unsigned char)src[i])) {
+    i++;
+  }
+
+  if (i >= len || TAG_ARG_QUOTE != src[i]) {
+    return false;
+  }
+
+  const size_t arg_start = ++i;
+  while (i < len && TAG_ARG_QUOTE != src[i] && !IS_EOL(src[i])) {
+    i++;
+  }
+
+  const size_t arg_len = i - arg_start;
+  if (i >= len || TAG_ARG_QUOTE != src[i] || 0 == arg_len ||
+      PARSE_MAX_PATH <= arg_len) {
+    return false;
+  }
+
+  memcpy(arg, src + arg_start, arg_len);
+  arg[arg_len] = 0;
+
+  for (i++; i < len && isspace((unsigned char)src[i]); i++) {
+  }
+
+  if (i + 1 >= len || !IS_TAG_FIT(src[i]) || !IS_TAG_CLOSE(src[i + 1])) {
+    return false;
+  }
+
+  *off = i + 2;
+  return true;
+}
+
+int parse_buffer(const char     *src,
+                 size_t          len,
+                 FILE           *dst_file,
+                 parse_status_t *parse_status) {
+  size_t off = 0;
+  int    ret = 0;
+
+  while (0 == ret &&
+         find_tag_and_emit_buffer(src, len, &off, dst_file, parse_status)) {
+    if (PARSE_TAG_INCLUDE == parse_status->tag ||
+        PARSE_TAG_PROFILE == parse_status->tag) {
+      const bool include = PARSE_TAG_INCLUDE == parse_status->tag;
+      char       arg[PARSE_MAX_PATH];
+
+      // Skip "<?include" or "<?profile"
+      off += 2 + (include ? TAG_INCLUDE_LEN : TAG_PROFILE_LEN);
+      if (!collect_quoted_buffer(src, len, &off, arg)) {
+        log_error("malformed directive tag");
+        ret = -1;
+        continue;
+      }
+
+      ret = include ? include_and_emit(dst_file, parse_status, arg)
+                    : set_profile(parse_status, arg);
       continue;
     }
 
-    emit_html_end(dst_file);
+    // Skip "<?c" or "<?="
+    off += 3;
+    emit_tag_base(dst_file, parse_status->tag);
 
-    if (!collect_emit_c(src_file, dst_file, &parse_status)) {
-      return -1;
+    if (!collect_emit_c_buffer(src, len, &off, dst_file, parse_status)) {
+      ret = -1;
     }
 
-    parse_status.html_init = false;
+    emit_char(dst_file, COMMON_EOL_CHAR);
+    emit_tag_end(dst_file, parse_status->tag);
+  }
+
+  return ret;
+}
+
+// Section
+// Entry points
+
+int parse_source(FILE *src_file, FILE *dst_file, parse_status_t *parse_status) {
+  size_t      src_len = 0;
+  const char *src_map = fsmap_open(src_file, &src_len);
+
+  // Mapping does not read the file yet, so the contents seen by the
+  // callback are the ones that are translated
+  if (NULL != parse_status->input_fcn) {
+    parse_status->input_fcn(parse_status->src_path,
+                            src_file,
+                            src_map,
+                            src_len,
+                            parse_status->input_arg);
   }
 
-  if (parse_status.html_init) {
-    emit_html_end(dst_file);
+  // Non-seekable streams (pipes, etc) cannot be mapped
+  if (NULL == src_map) {
+    return parse_stream(src_file, dst_file, parse_status);
   }
 
-  emit_end(dst_file);
-  return 0;
+  int r = parse_buffer(src_map, src_len, dst_file, parse_status);
+  fsmap_close(src_map, src_len);
+  return r;
+}
+
+int parse_and_emit_stream(FILE *src_file, FILE *dst_file) {
+  parse_status_t parse_status = {0};
+
+  emit_base(dst_file);
+  int ret = parse_stream(src_file, dst_file, &parse_status);
+  return finish_and_emit(dst_file, &parse_status, ret);
+}
+
+int parse_and_emit_buffer(const char *src, size_t len, FILE *dst_file) {
+  parse_status_t parse_status = {0};
+
+  emit_base(dst_file);
+  int ret = parse_buffer(src, len, dst_file, &parse_status);
+  return finish_and_emit(dst_file, &parse_status, ret);
+}
+
+int parse_and_emit_file(FILE             *src_file,
+                        const char       *src_path,
+                        FILE             *dst_file,
+                        FILE             *deps_file,
+                        char             *profile,
+                        parse_input_fcn_t input_fcn,
+                        void             *input_arg) {
+  parse_status_t parse_status = {.src_path  = src_path,
+                                 .deps_file = deps_file,
+                                 .input_fcn = input_fcn,
+                                 .input_arg = input_arg,
+                                 .profile   = profile};
+
+  if (NULL != profile) {
+    profile[0] = 0;
+  }
+
+  emit_base(dst_file);
+  int ret = parse_source(src_file, dst_file, &parse_status);
+  return finish_and_emit(dst_file, &parse_status, ret);
+}
+
+int parse_and_emit(FILE *src_file, FILE *dst_file) {
+  return parse_and_emit_file(src_file, NULL, dst_file, NULL, NULL, NULL, NULL);
 }
@@ -0,0 +1,160 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compile.h"
+#include "hash.h"
+#include "log.h"
+#include "store.h"
+#include "util.h"
+
+#define STORE_ENTRY_FMT "%s/%016" PRIx64 ".so"
+#define STORE_ENTRY_LEN (1 + 16 + 3 + 1)
+#define STORE_BUF_SIZE  4096
+
+#define STORE_PROFILE_FMT "%s/" COMPILE_PROFILE_NAME ".gcda"
+#define STORE_PROFILE_LEN (1 + sizeof COMPILE_PROFILE_NAME + 5)
+
+// Profiles are only read when building with them
+static uint64_t hash_profile(uint64_t key, const char *profile_dir) {
+  if (NULL == profile_dir ||
+      !(compile_get_options() & COMPILE_OPT_PROFILE_USE)) {
+    return key;
+  }
+
+  char *profile_path = malloc(strlen(profile_dir) + STORE_PROFILE_LEN);
+  if (NULL == profile_path) {
+    return key;
+  }
+
+  sprintf(profile_path, STORE_PROFILE_FMT, profile_dir);
+  FILE *profile_file = fopen(profile_path, "r");
+  safe_free(profile_path);
+
+  if (NULL != profile_file) {
+    key = hash_file(key, profile_file);
+    fclose(profile_file);
+  }
+
+  return key;
+}
+
+char *store_entry_path(const char           *store_dir,
+                       const char           *c_file_path,
+                       const compile_page_t *page) {
+  FILE *c_file = fopen(c_file_path, "r");
+  if (NULL == c_file) {
+    return NULL;
+  }
+
+  uint64_t key = hash_str(HASH_SEED, EXT_HTMC_BUILD);
+  key          = hash_str(key, compile_signature());
+  key          = hash_str(key, compile_level());
+  key          = hash_file(key, c_file);
+  fclose(c_file);
+
+  if (NULL != page) {
+    key = hash_str(key, (NULL != page->flags) ? page->flags : "");
+    key = hash_profile(key, page->profile_dir);
+  }
+
+  char *entry_path = malloc(strlen(store_dir) + STORE_ENTRY_LEN);
+  if (NULL != entry_path) {
+    sprintf(entry_path, STORE_ENTRY_FMT, store_dir, key);
+  }
+
+  return entry_path;
+}
+
+bool store_has(const char *entry_path) {
+  return 0 == access(entry_path, R_OK);
+}
+
+int store_put(const char *tmp_path, const char *entry_path) {
+  if (0 != rename(tmp_path, entry_path)) {
+    log_error("unable to add shared object to artifact store");
+    remove(tmp_path);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+static bool copy_file(const char *src_path, const char *dst_path) {
+  FILE *src_file = fopen(src_path, "rb");
+  FILE *dst_file = fopen(dst_path, "wb");
+  bool  ok       = NULL != src_file && NULL != dst_file;
+
+  char   buf[STORE_BUF_SIZE];
+  size_t nread;
+  while (ok && 0 < (nread = fread(buf, 1, sizeof buf, src_file))) {
+    ok = nread == fwrite(buf, 1, nread, dst_file);
+  }
+
+  if (NULL != src_file) {
+    ok = !ferror(src_file) && ok;
+    fclose(src_file);
+  }
+
+  if (NULL != dst_file) {
+    ok = 0 == fclose(dst_file) && ok;
+  }
+
+  return ok;
+}
+
+int store_install(const char *entry_path, const char *dst_path) {
+  char *tmp_path = tmp_path_for(dst_path);
+  if (NULL == tmp_path) {
+    log_fatal("out of memory");
+    return EXIT_FAILURE;
+  }
+
+  // Stores on other file systems (e.g. mounted in a container) cannot
+  // be linked to and are copied instead
+  remove(tmp_path);
+  bool ok = 0 == link(entry_path, tmp_path) || copy_file(entry_path, tmp_path);
+  ok      = ok && 0 == rename(tmp_path, dst_path);
+
+  if (!ok) {
+    log_error("unable to install shared object from artifact store");
+  }
+
+  // Renaming a link over another link to the same file does nothing,
+  // so the temporary link may still be there
+  remove(tmp_path);
+
+  safe_free(tmp_path);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
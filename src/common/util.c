@@ -19,10 +19,33 @@
 // LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+
+#define TMP_PATH_FMT "%s.%ld.tmp"
+#define TMP_PATH_EXT 32
 
 void safe_free(void *ptr) {
   if (ptr) {
     free(ptr);
   }
 }
+
+char *tmp_path_for(const char *path) {
+  char *tmp_path = malloc(strlen(path) + TMP_PATH_EXT);
+
+  if (NULL != tmp_path) {
+    sprintf(tmp_path, TMP_PATH_FMT, path, (long)getpid());
+  }
+
+  return tmp_path;
+}
@@ -24,6 +24,10 @@
 #define _POSIX_SOURCE
 #endif
 
+#ifndef _DARWIN_C_SOURCE
+#define _DARWIN_C_SOURCE
+#endif
+
 #include <stdio.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -31,6 +35,11 @@
 
 #include "fscache.h"
 
+#define ST_MTIM st_mtimespec
+#define ST_CTIM st_ctimespec
+#define TIMESPEC_NS(ts) \
+  ((uint64_t)(ts).tv_sec * 1000000000 + (uint64_t)(ts).tv_nsec)
+
 double fscache_cmp_ff(FILE *f1, FILE *f2) {
   struct stat f1_stat;
   struct stat f2_stat;
@@ -72,3 +81,45 @@ double fscache_cmp_fp(FILE *f1, const char *f2) {
 
   return difftime(f1_stat.st_mtime, f2_stat.st_mtime);
 }
+
+static fscache_sig_t stat_to_sig(const struct stat *file_stat) {
+  return (fscache_sig_t){.dev      = file_stat->st_dev,
+                         .ino      = file_stat->st_ino,
+                         .size     = file_stat->st_size,
+                         .mtime_ns = TIMESPEC_NS(file_stat->ST_MTIM),
+                         .ctime_ns = TIMESPEC_NS(file_stat->ST_CTIM)};
+}
+
+bool fscache_sig_p(const char *path, fscache_sig_t *sig) {
+  struct stat file_stat;
+
+  if (0 != stat(path, &file_stat)) {
+    return false;
+  }
+
+  *sig = stat_to_sig(&file_stat);
+  return true;
+}
+
+bool fscache_sig_f(FILE *file, fscache_sig_t *sig) {
+  struct stat file_stat;
+
+  if (0 != fstat(fileno(file), &file_stat)) {
+    return false;
+  }
+
+  *sig = stat_to_sig(&file_stat);
+  return true;
+}
+
+bool fscache_sig_eq(const fscache_sig_t *s1, const fscache_sig_t *s2) {
+  return s1->dev == s2->dev && s1->ino == s2->ino && s1->size == s2->size &&
+         s1->mtime_ns == s2->mtime_ns && s1->ctime_ns == s2->ctime_ns;
+}
+
+bool fscache_watch(const char *dir_path) {
+  return false; // not supported, signatures are always read from disk
+}
+
+void fscache_unwatch() {
+}
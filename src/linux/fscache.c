@@ -20,16 +20,52 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
-#ifndef _POSIX_SOURCE
-#define _POSIX_SOURCE
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
 #endif
 
+#include <dirent.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "fscache.h"
+#include "hash.h"
+
+#define ST_MTIM st_mtim
+#define ST_CTIM st_ctim
+#define TIMESPEC_NS(ts) \
+  ((uint64_t)(ts).tv_sec * 1000000000 + (uint64_t)(ts).tv_nsec)
+
+#define FSCACHE_TABLE_SIZE 1024
+#define FSCACHE_EVENT_BUF  4096
+#define FSCACHE_WATCH_MASK                                               \
+  (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | \
+   IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+typedef struct fscache_entry {
+  char                 *path;
+  bool                  exists;
+  fscache_sig_t         sig;
+  struct fscache_entry *next;
+} fscache_entry_t;
+
+typedef struct {
+  int   wd;
+  char *dir_path;
+} fscache_watch_t;
+
+fscache_entry_t *fscacheTable[FSCACHE_TABLE_SIZE];
+fscache_watch_t *fscacheWatches    = NULL;
+size_t           fscacheNumWatches = 0;
+size_t           fscacheCapWatches = 0;
+int              fscacheWatchFd    = -1;
+pthread_mutex_t  fscacheLock       = PTHREAD_MUTEX_INITIALIZER;
 
 double fscache_cmp_ff(FILE *f1, FILE *f2) {
   struct stat f1_stat;
@@ -72,3 +108,336 @@ double fscache_cmp_fp(FILE *f1, const char *f2) {
 
   return difftime(f1_stat.st_mtime, f2_stat.st_mtime);
 }
+
+static fscache_sig_t stat_to_sig(const struct stat *file_stat) {
+  return (fscache_sig_t){.dev      = file_stat->st_dev,
+                         .ino      = file_stat->st_ino,
+                         .size     = file_stat->st_size,
+                         .mtime_ns = TIMESPEC_NS(file_stat->ST_MTIM),
+                         .ctime_ns = TIMESPEC_NS(file_stat->ST_CTIM)};
+}
+
+static bool stat_sig(const char *path, fscache_sig_t *sig) {
+  struct stat file_stat;
+
+  if (0 != stat(path, &file_stat)) {
+    return false;
+  }
+
+  *sig = stat_to_sig(&file_stat);
+  return true;
+}
+
+// Section
+// Watched signatures
+
+// Paths are compared as given, except for leading "./"
+static const char *skip_dot(const char *path) {
+  while ('.' == path[0] && '/' == path[1]) {
+    path += 2;
+  }
+
+  return path;
+}
+
+static char *join_path(const char *dir_path, const char *name) {
+  if (0 == strcmp(dir_path, ".")) {
+    return strdup(name);
+  }
+
+  char *path = malloc(strlen(dir_path) + strlen(name) + 2);
+  if (NULL != path) {
+    sprintf(path, "%s/%s", dir_path, name);
+  }
+
+  return path;
+}
+
+static bool is_watched_file(const char *path) {
+  const char *slash   = strrchr(path, '/');
+  const char *dir     = (NULL != slash) ? path : ".";
+  size_t      dir_len = (NULL != slash) ? (size_t)(slash - path) : 1;
+
+  for (size_t i = 0; i < fscacheNumWatches; i++) {
+    const char *watched = fscacheWatches[i].dir_path;
+
+    if (dir_len == strlen(watched) && 0 == strncmp(dir, watched, dir_len)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static fscache_entry_t **find_entry(const char *path) {
+  size_t bucket = hash_str(HASH_SEED, path) % FSCACHE_TABLE_SIZE;
+
+  fscache_entry_t **slot = &fscacheTable[bucket];
+  while (NULL != *slot && 0 != strcmp((*slot)->path, path)) {
+    slot = &(*slot)->next;
+  }
+
+  return slot;
+}
+
+static void forget_entry(const char *path) {
+  fscache_entry_t **slot  = find_entry(path);
+  fscache_entry_t  *entry = *slot;
+
+  if (NULL != entry) {
+    *slot = entry->next;
+    free(entry->path);
+    free(entry);
+  }
+}
+
+static void clear_table() {
+  for (size_t i = 0; i < FSCACHE_TABLE_SIZE; i++) {
+    fscache_entry_t *entry = fscacheTable[i];
+    fscacheTable[i]        = NULL;
+
+    while (NULL != entry) {
+      fscache_entry_t *next = entry->next;
+      free(entry->path);
+      free(entry);
+      entry = next;
+    }
+  }
+}
+
+// Watches are not recursive, so every directory in the tree gets one
+static bool add_watch(const char *dir_path) {
+  int wd = inotify_add_watch(fscacheWatchFd, dir_path, FSCACHE_WATCH_MASK);
+  if (-1 == wd) {
+    return false;
+  }
+
+  if (fscacheNumWatches == fscacheCapWatches) {
+    size_t cap = (0 == fscacheCapWatches) ? 16 : 2 * fscacheCapWatches;
+    fscache_watch_t *watches =
+        realloc(fscacheWatches, cap * sizeof(fscache_watch_t));
+
+    if (NULL == watches) {
+      return false;
+    }
+
+    fscacheWatches    = watches;
+    fscacheCapWatches = cap;
+  }
+
+  char *path = strdup(dir_path);
+  if (NULL == path) {
+    return false;
+  }
+
+  fscacheWatches[fscacheNumWatches++] = (fscache_watch_t){wd, path};
+
+  DIR *dir = opendir(dir_path);
+  if (NULL == dir) {
+    return false;
+  }
+
+  bool           ok = true;
+  struct dirent *ent;
+
+  while (ok && NULL != (ent = readdir(dir))) {
+    if (0 == strcmp(ent->d_name, ".") || 0 == strcmp(ent->d_name, "..")) {
+      continue;
+    }
+
+    struct stat child_stat;
+    char       *child = join_path(dir_path, ent->d_name);
+
+    ok = NULL != child;
+    if (ok && 0 == lstat(child, &child_stat) && S_ISDIR(child_stat.st_mode)) {
+      ok = add_watch(child);
+    }
+
+    free(child);
+  }
+
+  closedir(dir);
+  return ok;
+}
+
+// Drops the watches of a directory and of the ones below it, files
+// there are read from disk until they are watched again
+static void drop_watches(const char *dir_path) {
+  size_t dir_len = strlen(dir_path);
+
+  for (size_t i = 0; i < fscacheNumWatches;) {
+    const char *watched = fscacheWatches[i].dir_path;
+
+    if (0 != strncmp(watched, dir_path, dir_len) ||
+        (0 != watched[dir_len] && '/' != watched[dir_len])) {
+      i++;
+      continue;
+    }
+
+    free(fscacheWatches[i].dir_path);
+    fscacheWatches[i] = fscacheWatches[--fscacheNumWatches];
+  }
+}
+
+static void handle_event(const struct inotify_event *event) {
+  // Some events were lost, any entry may be stale
+  if (IN_Q_OVERFLOW & event->mask) {
+    clear_table();
+    return;
+  }
+
+  for (size_t i = 0; i < fscacheNumWatches; i++) {
+    if (event->wd != fscacheWatches[i].wd) {
+      continue;
+    }
+
+    // The directory is gone or has another name now
+    if ((IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED) & event->mask) {
+      clear_table();
+      drop_watches(fscacheWatches[i].dir_path);
+      return;
+    }
+
+    if (0 == event->len) {
+      continue;
+    }
+
+    char *path = join_path(fscacheWatches[i].dir_path, event->name);
+    if (NULL == path) {
+      clear_table();
+      return;
+    }
+
+    forget_entry(path);
+
+    if ((IN_ISDIR & event->mask) && (IN_MOVED_FROM & event->mask)) {
+      clear_table();
+      drop_watches(path);
+    }
+
+    if ((IN_ISDIR & event->mask) && ((IN_CREATE | IN_MOVED_TO) & event->mask)) {
+      add_watch(path);
+    }
+
+    free(path);
+    return;
+  }
+}
+
+// Events are queued by the time the change that caused them returns,
+// so draining them before a lookup is enough to never serve a stale
+// signature
+static void drain_events() {
+  char buf[FSCACHE_EVENT_BUF]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+
+  while (0 < (len = read(fscacheWatchFd, buf, sizeof buf))) {
+    for (char *ptr = buf; ptr < buf + len;) {
+      const struct inotify_event *event = (const struct inotify_event *)ptr;
+
+      handle_event(event);
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+  }
+}
+
+bool fscache_watch(const char *dir_path) {
+  char *path = strdup(skip_dot(dir_path));
+  if (NULL == path) {
+    return false;
+  }
+
+  size_t path_len = strlen(path);
+  while (1 < path_len && '/' == path[path_len - 1]) {
+    path[--path_len] = 0;
+  }
+
+  pthread_mutex_lock(&fscacheLock);
+
+  if (-1 == fscacheWatchFd) {
+    fscacheWatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  }
+
+  bool ok = -1 != fscacheWatchFd && add_watch((0 == path_len) ? "." : path);
+
+  pthread_mutex_unlock(&fscacheLock);
+  free(path);
+  return ok;
+}
+
+void fscache_unwatch() {
+  pthread_mutex_lock(&fscacheLock);
+
+  if (-1 != fscacheWatchFd) {
+    close(fscacheWatchFd);
+    fscacheWatchFd = -1;
+  }
+
+  for (size_t i = 0; i < fscacheNumWatches; i++) {
+    free(fscacheWatches[i].dir_path);
+  }
+
+  clear_table();
+  free(fscacheWatches);
+  fscacheWatches    = NULL;
+  fscacheNumWatches = 0;
+  fscacheCapWatches = 0;
+
+  pthread_mutex_unlock(&fscacheLock);
+}
+
+bool fscache_sig_p(const char *path, fscache_sig_t *sig) {
+  pthread_mutex_lock(&fscacheLock);
+
+  if (-1 == fscacheWatchFd) {
+    pthread_mutex_unlock(&fscacheLock);
+    return stat_sig(path, sig);
+  }
+
+  drain_events();
+
+  const char       *key   = skip_dot(path);
+  fscache_entry_t **slot  = find_entry(key);
+  fscache_entry_t  *entry = *slot;
+
+  // Files that do not exist are remembered as well
+  if (NULL == entry && is_watched_file(key) &&
+      NULL != (entry = calloc(1, sizeof(fscache_entry_t)))) {
+    entry->path   = strdup(key);
+    entry->exists = stat_sig(key, &entry->sig);
+
+    if (NULL == entry->path) {
+      free(entry);
+      entry = NULL;
+    } else {
+      *slot = entry;
+    }
+  }
+
+  bool exists = (NULL != entry) ? entry->exists : stat_sig(path, sig);
+  if (NULL != entry) {
+    *sig = entry->sig;
+  }
+
+  pthread_mutex_unlock(&fscacheLock);
+  return exists;
+}
+
+// Open files are not looked up in the table, their path may have been
+// replaced since they were opened
+bool fscache_sig_f(FILE *file, fscache_sig_t *sig) {
+  struct stat file_stat;
+
+  if (0 != fstat(fileno(file), &file_stat)) {
+    return false;
+  }
+
+  *sig = stat_to_sig(&file_stat);
+  return true;
+}
+
+bool fscache_sig_eq(const fscache_sig_t *s1, const fscache_sig_t *s2) {
+  return s1->dev == s2->dev && s1->ino == s2->ino && s1->size == s2->size &&
+         s1->mtime_ns == s2->mtime_ns && s1->ctime_ns == s2->ctime_ns;
+}
@@ -0,0 +1,67 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "fslock.h"
+
+int fslock_acquire(const char *path, bool wait) {
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (0 > fd) {
+    return -1;
+  }
+
+  // flock locks belong to the open file, not to the process, so they
+  // also exclude other descriptors in the same process
+  int ret;
+  do {
+    ret = flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB));
+  } while (0 != ret && EINTR == errno);
+
+  if (0 != ret) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+void fslock_release(int handle) {
+  if (0 <= handle) {
+    flock(handle, LOCK_UN);
+    close(handle);
+  }
+}
+
+void fslock_detach(int handle) {
+  if (0 <= handle) {
+    close(handle);
+  }
+}
@@ -33,3 +33,22 @@ double fscache_cmp_pp(const char *p1, const char *p2) {
 double fscache_cmp_fp(FILE *f1, const char *f2) {
   return 0; // temporary
 }
+
+bool fscache_sig_p(const char *path, fscache_sig_t *sig) {
+  return false; // temporary, pages are always rebuilt
+}
+
+bool fscache_sig_f(FILE *file, fscache_sig_t *sig) {
+  return false; // temporary, pages are always rebuilt
+}
+
+bool fscache_sig_eq(const fscache_sig_t *s1, const fscache_sig_t *s2) {
+  return false; // temporary
+}
+
+bool fscache_watch(const char *dir_path) {
+  return false; // not supported, signatures are always read from disk
+}
+
+void fscache_unwatch() {
+}
@@ -0,0 +1,167 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks the arena behind htmc_alloc: alignment, chunk growth, the
+// memory cap, reuse of chunks after a reset and high-water tracking
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libhtmc/libhtmc-internals.h"
+
+#define TEST_ALIGN      _Alignof(max_align_t)
+#define TEST_CHUNK_SIZE 8192
+#define TEST_CHUNK_MAX  (1024 * 1024)
+
+int testFailed = 0;
+
+static void check(bool ok, const char *name) {
+  if (!ok) {
+    printf("FAIL arena: %s\n", name);
+    testFailed++;
+  }
+}
+
+static bool is_aligned(const void *ptr) {
+  return NULL != ptr && 0 == (uintptr_t)ptr % TEST_ALIGN;
+}
+
+static void test_alignment() {
+  htmc_arena_t *arena = htmc_arena_create(0);
+  bool          ok    = NULL != arena;
+
+  for (size_t size = 1; ok && size < 100; size += 7) {
+    ok = is_aligned(htmc_arena_alloc(arena, size));
+  }
+
+  check(ok, "allocations are aligned to max_align_t");
+  htmc_arena_destroy(arena);
+}
+
+// Each new chunk is twice as large as the previous one, up to 1 MB
+static void test_growth() {
+  htmc_arena_t *arena    = htmc_arena_create(0);
+  size_t        expected = TEST_CHUNK_SIZE;
+  size_t        reserved = 0;
+  bool          ok       = NULL != arena;
+
+  for (int i = 0; ok && i < 64 * 1024; i++) {
+    ok = NULL != htmc_arena_alloc(arena, 256);
+
+    size_t now = htmc_arena_stats(arena).reserved;
+    if (ok && now != reserved) {
+      ok       = now - reserved == expected;
+      reserved = now;
+      expected = (2 * expected < TEST_CHUNK_MAX) ? 2 * expected
+                                                 : TEST_CHUNK_MAX;
+    }
+  }
+
+  check(ok, "chunks double up to 1 MB");
+  check(TEST_CHUNK_MAX == expected, "chunks reach 1 MB");
+
+  // Larger allocations get a chunk of their own
+  size_t large = 3 * TEST_CHUNK_MAX;
+  reserved     = htmc_arena_stats(arena).reserved;
+
+  check(is_aligned(htmc_arena_alloc(arena, large)), "large allocation");
+  check(large == htmc_arena_stats(arena).reserved - reserved,
+        "large allocation has its own chunk");
+  htmc_arena_destroy(arena);
+}
+
+static void test_cap() {
+  htmc_arena_t *arena = htmc_arena_create(4096);
+
+  check(NULL != htmc_arena_alloc(arena, 4000), "allocation under the cap");
+  check(NULL == htmc_arena_alloc(arena, 200), "allocation over the cap");
+  check(NULL != htmc_arena_alloc(arena, 64), "allocation up to the cap");
+  check(4064 == htmc_arena_stats(arena).used, "failed allocations use none");
+
+  // The cap applies to the memory in use, which a reset gives back
+  htmc_arena_reset(arena);
+  check(NULL != htmc_arena_alloc(arena, 4000), "allocation after reset");
+  htmc_arena_destroy(arena);
+}
+
+static bool run_request(htmc_arena_t *arena, void **first) {
+  *first = htmc_arena_alloc(arena, 100);
+
+  for (int i = 0; NULL != *first && i < 1000; i++) {
+    if (NULL == htmc_arena_alloc(arena, 100 + i)) {
+      return false;
+    }
+  }
+
+  return NULL != *first;
+}
+
+// A request like the previous one is served from the same chunks
+static void test_reuse() {
+  htmc_arena_t *arena = htmc_arena_create(0);
+  void         *first1;
+  void         *first2;
+
+  check(run_request(arena, &first1), "first request");
+  size_t reserved = htmc_arena_stats(arena).reserved;
+
+  htmc_arena_reset(arena);
+  check(0 == htmc_arena_stats(arena).used, "reset releases memory");
+  check(run_request(arena, &first2), "second request");
+  check(first1 == first2, "second request starts in the first chunk");
+  check(reserved == htmc_arena_stats(arena).reserved,
+        "second request allocates no chunk");
+  htmc_arena_destroy(arena);
+}
+
+static void test_high_water() {
+  htmc_arena_t *arena = htmc_arena_create(0);
+
+  htmc_arena_alloc(arena, 100000);
+  htmc_arena_reset(arena);
+  htmc_arena_alloc(arena, 1000);
+
+  htmc_arena_stats_t stats = htmc_arena_stats(arena);
+  check(100000 <= stats.high_water && 100000 + TEST_ALIGN > stats.high_water,
+        "high water survives a reset");
+  check(1000 <= stats.used && 1000 + TEST_ALIGN > stats.used,
+        "memory in use after reset");
+  htmc_arena_destroy(arena);
+}
+
+int main() {
+  test_alignment();
+  test_growth();
+  test_cap();
+  test_reuse();
+  test_high_water();
+
+  if (0 != testFailed) {
+    return EXIT_FAILURE;
+  }
+
+  printf("arena: allocations, growth, cap and reuse behave\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks that different pages never share artifacts or store entries:
+// paths that flattened to the same name used to collide
+// Must be run from the root of the repository
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "build.h"
+#include "compile.h"
+#include "log.h"
+
+#define TEST_DIR "tmp/test-build"
+
+int testFailed = 0;
+
+static void check(bool ok, const char *name) {
+  if (!ok) {
+    printf("FAIL build: %s\n", name);
+    testFailed++;
+  }
+}
+
+// Returns true if both pages get different artifacts
+static bool distinct(const char *src_a, const char *src_b) {
+  build_paths_t a;
+  build_paths_t b;
+
+  if (!build_paths_init(&a, TEST_DIR, src_a)) {
+    return false;
+  }
+
+  if (!build_paths_init(&b, TEST_DIR, src_b)) {
+    build_paths_free(&a);
+    return false;
+  }
+
+  bool ok = 0 != strcmp(a.c_file_path, b.c_file_path) &&
+            0 != strcmp(a.so_file_path, b.so_file_path) &&
+            0 != strcmp(a.sum_file_path, b.sum_file_path);
+
+  build_paths_free(&a);
+  build_paths_free(&b);
+  return ok;
+}
+
+int main(void) {
+  log_set_level(HTMC_LOG_LEVEL_OFF);
+  log_set_safe();
+
+  check(distinct("a/b_c.htmc", "a_b/c.htmc"), "separator and underscore");
+  check(distinct("a/b.htmc", "a%2Fb.htmc"), "separator and escape");
+  check(distinct("a\\b.htmc", "a/b.htmc"), "both separators");
+  check(distinct("a%25.htmc", "a%.htmc"), "escaped escape");
+
+  // The signature names the compiler version and target, not only the
+  // program, so a new compiler invalidates the store
+  const char *signature = compile_signature();
+  check(0 == strncmp(signature, "gcc ", 4) &&
+            NULL != strchr("0123456789", signature[4]),
+        "compiler version");
+
+  if (0 != testFailed) {
+    return EXIT_FAILURE;
+  }
+
+  printf("build: different pages never share artifacts\n");
+  return EXIT_SUCCESS;
+}
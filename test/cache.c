@@ -0,0 +1,203 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks that build manifests follow the contents of their inputs rather
+// than their modification times
+// Must be run from the root of the repository
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "log.h"
+
+#define TEST_DIR     "tmp/test-cache"
+#define TEST_PAGE    TEST_DIR "/page.htmc"
+#define TEST_PARTIAL TEST_DIR "/partial.htmc"
+#define TEST_OUT     TEST_DIR "/page.so"
+#define TEST_SUM     TEST_DIR "/page.sum"
+#define TEST_FAIL    TEST_DIR "/page.fail"
+#define TEST_DIAG    "partial.htmc:1: error\n"
+
+int testFailed = 0;
+
+static void check(bool ok, const char *name) {
+  if (!ok) {
+    printf("FAIL cache: %s\n", name);
+    testFailed++;
+  }
+}
+
+static bool write_file(const char *path, const char *s) {
+  FILE *file = fopen(path, "w");
+  return NULL != file && 0 <= fputs(s, file) && 0 == fclose(file);
+}
+
+// Timestamps are set explicitly, files written within the same clock
+// tick could otherwise keep the same signature
+static bool set_mtime(const char *path, time_t mtime) {
+  struct timespec times[2] = {{.tv_sec = mtime}, {.tv_sec = mtime}};
+  return 0 == utimensat(AT_FDCWD, path, times, 0);
+}
+
+static ino_t inode_of(const char *path) {
+  struct stat file_stat;
+  return (0 == stat(path, &file_stat)) ? file_stat.st_ino : 0;
+}
+
+static cache_inputs_t *record_inputs() {
+  cache_inputs_t *inputs = cache_inputs_create();
+
+  if (NULL != inputs) {
+    cache_inputs_add_path(inputs, TEST_PAGE);
+    cache_inputs_add_path(inputs, TEST_PARTIAL);
+  }
+
+  return inputs;
+}
+
+static bool store(const char *sum_path, const char *out_path) {
+  cache_inputs_t *inputs = record_inputs();
+  bool            ok     = NULL != inputs &&
+                  EXIT_SUCCESS == cache_store(sum_path, inputs, out_path);
+
+  cache_inputs_free(inputs);
+  return ok;
+}
+
+static bool store_failure() {
+  cache_inputs_t *inputs = record_inputs();
+  size_t          len    = strlen(TEST_DIAG);
+  bool            ok     = NULL != inputs &&
+                  EXIT_SUCCESS ==
+                      cache_store_failure(TEST_FAIL, inputs, TEST_DIAG, len);
+
+  cache_inputs_free(inputs);
+  return ok;
+}
+
+// Returns true if the failure still applies and its diagnostics were
+// kept
+static bool failed() {
+  char *diagnostics = NULL;
+  bool  ok          = cache_failed(TEST_FAIL, &diagnostics) &&
+                  NULL != diagnostics && 0 == strcmp(diagnostics, TEST_DIAG);
+
+  free(diagnostics);
+  return ok;
+}
+
+static void clean_up() {
+  remove(TEST_FAIL);
+  remove(TEST_SUM);
+  remove(TEST_OUT);
+  remove(TEST_PARTIAL);
+  remove(TEST_PAGE);
+  rmdir(TEST_DIR);
+}
+
+static void test_manifest() {
+  check(write_file(TEST_PAGE, "<?include \"partial.htmc\" ?>") &&
+            write_file(TEST_PARTIAL, "a") && write_file(TEST_OUT, "so"),
+        "create inputs");
+  check(!cache_fresh(TEST_SUM, TEST_OUT), "missing manifest");
+  check(store(TEST_SUM, TEST_OUT), "store");
+  check(cache_fresh(TEST_SUM, TEST_OUT), "fresh");
+  check(!cache_fresh(TEST_SUM, TEST_PAGE), "other artifact");
+
+  // The contents are hashed again and the manifest is rewritten with
+  // the new signature, so that the next check does not hash them
+  ino_t sum_inode = inode_of(TEST_SUM);
+  check(set_mtime(TEST_PARTIAL, 1000000000), "touch");
+  check(cache_fresh(TEST_SUM, TEST_OUT), "touched but unchanged");
+  check(inode_of(TEST_SUM) != sum_inode, "manifest refreshed");
+  check(cache_fresh(TEST_SUM, TEST_OUT), "fresh after refresh");
+
+  // Same size, so that only the contents tell the versions apart
+  check(write_file(TEST_PARTIAL, "b") && set_mtime(TEST_PARTIAL, 1000000001),
+        "edit");
+  check(!cache_fresh(TEST_SUM, TEST_OUT), "edited");
+  check(write_file(TEST_PARTIAL, "a") && set_mtime(TEST_PARTIAL, 1000000002),
+        "revert");
+  check(cache_fresh(TEST_SUM, TEST_OUT), "reverted");
+
+  // Artifacts are never hashed, replacing one makes it stale
+  check(write_file(TEST_OUT, "other"), "replace artifact");
+  check(!cache_fresh(TEST_SUM, TEST_OUT), "artifact replaced");
+  check(store(TEST_SUM, TEST_OUT) && cache_fresh(TEST_SUM, TEST_OUT),
+        "stored again");
+
+  check(0 == remove(TEST_PARTIAL), "delete input");
+  check(!cache_fresh(TEST_SUM, TEST_OUT), "input deleted");
+  check(!store(TEST_SUM, TEST_OUT), "store without input");
+}
+
+// Failures are not attempted again until one of their inputs changes
+static void test_failure() {
+  check(write_file(TEST_PAGE, "<?include \"partial.htmc\" ?>") &&
+            write_file(TEST_PARTIAL, "<?c broken ?>"),
+        "create broken inputs");
+  check(!cache_failed(TEST_FAIL, NULL), "missing failure");
+  check(store_failure(), "store failure");
+  check(failed(), "failed");
+
+  check(set_mtime(TEST_PARTIAL, 1000000000), "touch broken");
+  check(failed(), "touched but still broken");
+
+  check(write_file(TEST_PARTIAL, "<?c fixed! ?>") &&
+            set_mtime(TEST_PARTIAL, 1000000001),
+        "fix");
+  check(!cache_failed(TEST_FAIL, NULL), "cleared by fix");
+
+  check(store_failure() && 0 == remove(TEST_PARTIAL), "delete broken");
+  check(!cache_failed(TEST_FAIL, NULL), "cleared by deletion");
+  check(!store_failure(), "store failure without input");
+}
+
+int main() {
+  log_set_level(HTMC_LOG_LEVEL_OFF);
+  log_set_safe();
+
+  clean_up();
+  mkdir("tmp", 0755);
+  check(0 == mkdir(TEST_DIR, 0755), "create directory");
+
+  test_manifest();
+  test_failure();
+
+  clean_up();
+  if (0 != testFailed) {
+    return EXIT_FAILURE;
+  }
+
+  printf("cache: manifests and failures follow the contents of inputs\n");
+  return EXIT_SUCCESS;
+}
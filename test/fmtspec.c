@@ -0,0 +1,111 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks which htmc_printf calls are rewritten into direct writes and
+// that every other call is left for htmc_printf to format
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmtspec.h"
+
+int testFailed = 0;
+
+static void check(bool ok, const char *name) {
+  if (!ok) {
+    printf("FAIL fmtspec: %s\n", name);
+    testFailed++;
+  }
+}
+
+static bool emits(const char *code, const char *expected) {
+  char  *out     = NULL;
+  size_t out_len = 0;
+  FILE  *dst     = open_memstream(&out, &out_len);
+
+  if (NULL == dst) {
+    return false;
+  }
+
+  fmtspec_emit_c(dst, code, strlen(code));
+  fclose(dst);
+
+  bool ok = 0 == strcmp(out, expected);
+  free(out);
+  return ok;
+}
+
+// Calls that are not rewritten are emitted exactly as written
+static bool kept(const char *code) {
+  return emits(code, code);
+}
+
+int main(void) {
+  check(emits("htmc_printf(\"<b>%d</b>\", n);",
+              "{ htmc_write_literal(\"<b>\"); htmc_put_int((int)(n)); "
+              "htmc_write_literal(\"</b>\"); }"),
+        "int");
+  check(emits("htmc_printf(\"%s!\", user->name);",
+              "{ htmc_put_str((const char *)(user->name)); "
+              "htmc_write_literal(\"!\"); }"),
+        "string");
+  check(emits("htmc_printf(\"%.2f EUR\", price);",
+              "{ htmc_printf(\"%.2f\", (double)(price)); "
+              "htmc_write_literal(\" EUR\"); }"),
+        "precision");
+  check(emits("htmc_printf(\"100%% %zu\", len);",
+              "{ htmc_write_literal(\"100%\"); htmc_write_literal(\" \"); "
+              "htmc_put_uint((size_t)(len)); }"),
+        "percent sign");
+
+  // Line numbers of the code that follows are kept
+  check(emits("htmc_printf(\"%d\",\n  n);\nx;",
+              "{ htmc_put_int((int)(n)); }\n\nx;"),
+        "lines");
+
+  check(kept("htmc_printf(\"%*d\", width, n);"), "width argument");
+  check(kept("htmc_printf(\"%5d\", n);"), "width");
+  check(kept("htmc_printf(\"%.2d\", n);"), "integer precision");
+  check(kept("htmc_printf(\"%d%n\", n, &len);"), "written count");
+  check(kept("htmc_printf(\"%Lf\", x);"), "long double");
+  check(kept("htmc_printf(fmt, n);"), "format variable");
+  check(kept("htmc_printf(\"%d\" SUFFIX, n);"), "format macro");
+  check(kept("htmc_printf(\"\\x25d\", n);"), "escaped conversion");
+  check(kept("htmc_printf(\"%d %d\", n);"), "missing argument");
+  check(kept("htmc_printf(\"%d\", next());"), "call argument");
+  check(kept("htmc_printf(\"%d\", i++);"), "increment argument");
+  check(kept("n = htmc_printf(\"%d\", n);"), "used result");
+  check(kept("if (n) htmc_printf(\"%d\", n);"), "unbraced statement");
+
+  if (0 != testFailed) {
+    return EXIT_FAILURE;
+  }
+
+  printf("fmtspec: literal formats are rewritten, others kept\n");
+  return EXIT_SUCCESS;
+}
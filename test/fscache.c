@@ -0,0 +1,167 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks that signatures served from watched directories follow the
+// files they describe when those are written, replaced or deleted
+// Must be run from the root of the repository
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fscache.h"
+#include "log.h"
+
+#define TEST_DIR     "tmp/test-fscache"
+#define TEST_WATCHED TEST_DIR "/watched"
+#define TEST_OTHER   TEST_DIR "/other"
+#define TEST_FILE    TEST_WATCHED "/page.htmc"
+#define TEST_NEW     TEST_WATCHED "/page.htmc.tmp"
+#define TEST_SUB     TEST_WATCHED "/sub"
+#define TEST_SUBFILE TEST_SUB "/partial.htmc"
+#define TEST_LINKED  TEST_WATCHED "/linked.htmc"
+#define TEST_LINK    TEST_OTHER "/link.htmc"
+
+int testFailed = 0;
+
+static void check(bool ok, const char *name) {
+  if (!ok) {
+    printf("FAIL fscache: %s\n", name);
+    testFailed++;
+  }
+}
+
+static bool write_file(const char *path, const char *mode, const char *s) {
+  FILE *file = fopen(path, mode);
+  return NULL != file && 0 <= fputs(s, file) && 0 == fclose(file);
+}
+
+// Signature of the file as read from disk right now
+static bool disk_sig(const char *path, fscache_sig_t *sig) {
+  struct stat file_stat;
+  if (0 != stat(path, &file_stat)) {
+    return false;
+  }
+
+  *sig = (fscache_sig_t){
+      .dev      = file_stat.st_dev,
+      .ino      = file_stat.st_ino,
+      .size     = file_stat.st_size,
+      .mtime_ns = file_stat.st_mtim.tv_sec * 1000000000ULL +
+                  file_stat.st_mtim.tv_nsec,
+      .ctime_ns = file_stat.st_ctim.tv_sec * 1000000000ULL +
+                  file_stat.st_ctim.tv_nsec};
+
+  return true;
+}
+
+static bool served_current(const char *path) {
+  fscache_sig_t served;
+  fscache_sig_t current;
+
+  return fscache_sig_p(path, &served) && disk_sig(path, &current) &&
+         fscache_sig_eq(&served, &current);
+}
+
+static void clean_up() {
+  remove(TEST_LINK);
+  remove(TEST_LINKED);
+  remove(TEST_SUBFILE);
+  remove(TEST_NEW);
+  remove(TEST_FILE);
+  rmdir(TEST_SUB);
+  rmdir(TEST_OTHER);
+  rmdir(TEST_WATCHED);
+  rmdir(TEST_DIR);
+}
+
+int main() {
+  log_set_level(HTMC_LOG_LEVEL_OFF);
+  log_set_safe();
+
+  clean_up();
+  mkdir("tmp", 0755);
+
+  bool ok = 0 == mkdir(TEST_DIR, 0755) && 0 == mkdir(TEST_WATCHED, 0755) &&
+            0 == mkdir(TEST_OTHER, 0755) && write_file(TEST_FILE, "w", "a");
+
+  // Linked before watching, linking changes the ctime of the file
+  ok = ok && write_file(TEST_LINKED, "w", "a") &&
+       0 == link(TEST_LINKED, TEST_LINK);
+
+  if (!ok || !fscache_watch(TEST_WATCHED)) {
+    printf("FAIL fscache: unable to watch " TEST_WATCHED "\n");
+    clean_up();
+    return EXIT_FAILURE;
+  }
+
+  fscache_sig_t before;
+  check(fscache_sig_p(TEST_FILE, &before), "lookup");
+  check(served_current(TEST_FILE), "first lookup");
+
+  check(write_file(TEST_FILE, "a", "b"), "append");
+  check(served_current(TEST_FILE), "written");
+
+  check(write_file(TEST_NEW, "w", "replaced") &&
+            0 == rename(TEST_NEW, TEST_FILE),
+        "replace");
+  check(served_current(TEST_FILE), "renamed over");
+
+  fscache_sig_t gone;
+  check(0 == remove(TEST_FILE), "remove");
+  check(!fscache_sig_p(TEST_FILE, &gone), "deleted");
+
+  check(write_file(TEST_FILE, "w", "a"), "create");
+  check(served_current(TEST_FILE), "created again");
+
+  // Directories created later are watched as well
+  check(0 == mkdir(TEST_SUB, 0755) && write_file(TEST_SUBFILE, "w", "a"),
+        "create directory");
+  check(served_current(TEST_SUBFILE), "new directory");
+  check(write_file(TEST_SUBFILE, "a", "b"), "append in new directory");
+  check(served_current(TEST_SUBFILE), "written in new directory");
+
+  // Changes through links in unwatched directories are not reported (see
+  // fscache.h), the stale signature shows that it comes from the table
+  check(served_current(TEST_LINKED), "linked file");
+  check(write_file(TEST_LINK, "a", "b"), "write through link");
+  check(!served_current(TEST_LINKED), "lookup served from memory");
+
+  // Without watches, signatures are read from disk again
+  fscache_unwatch();
+  check(served_current(TEST_LINKED), "unwatched");
+
+  clean_up();
+  if (0 != testFailed) {
+    return EXIT_FAILURE;
+  }
+
+  printf("fscache: watched signatures follow their files\n");
+  return EXIT_SUCCESS;
+}
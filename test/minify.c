@@ -0,0 +1,102 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks that minified markup only loses what browsers ignore: contents
+// of whitespace-sensitive elements are kept byte for byte
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minify.h"
+
+#define TEST_MAX_RUN 256
+
+int testFailed = 0;
+
+static void check(bool ok, const char *name) {
+  if (!ok) {
+    printf("FAIL minify: %s\n", name);
+    testFailed++;
+  }
+}
+
+// Minifies runs one after the other, as if split by code blocks, and
+// compares what is left of them with expected
+static bool minifies_to(const char **runs, const char *expected) {
+  minify_state_t state                  = {0};
+  char           out[TEST_MAX_RUN * 4] = "";
+
+  for (size_t i = 0; NULL != runs[i]; i++) {
+    char   run[TEST_MAX_RUN];
+    size_t len = strlen(runs[i]);
+
+    memcpy(run, runs[i], len);
+    len = minify_run(&state, run, len);
+    strncat(out, run, len);
+  }
+
+  return 0 == strcmp(out, expected);
+}
+
+static bool minifies_one(const char *run, const char *expected) {
+  const char *runs[] = {run, NULL};
+  return minifies_to(runs, expected);
+}
+
+int main(void) {
+  check(minifies_one("<p>  a \n\n b  </p>", "<p> a\nb </p>"), "whitespace");
+  check(minifies_one("a <!-- x --> b", "a b"), "comment");
+  check(minifies_one("<!--[if IE]>a<![endif]-->", "<!--[if IE]>a<![endif]-->"),
+        "conditional comment");
+  const char *attribute = "<a title=\"x  <!-- y -->\">";
+  check(minifies_one(attribute, attribute), "attribute");
+
+  const char *pre = "<pre>  a\n\n  <!-- b -->  </pre>";
+  check(minifies_one(pre, pre), "pre");
+
+  const char *textarea = "<textarea rows=\"2\">\n  a  <b>\n</textarea>";
+  check(minifies_one(textarea, textarea), "textarea");
+
+  const char *script = "<script>\n  if (a  <  b) {} // <!-- c -->\n</script>";
+  check(minifies_one(script, script), "script");
+
+  // Only the closing tag of the same element ends it
+  const char *nested = "<script>a  = \"</pre>  \";</script>";
+  check(minifies_one(nested, nested), "other closing tag");
+  check(minifies_one("<PRE>  a  </pre>  b", "<PRE>  a  </pre> b"),
+        "closing tag case");
+
+  // Elements and comments may be split by a code block
+  const char *split_pre[] = {"<pre>  a", "  b</pre>  c", NULL};
+  check(minifies_to(split_pre, "<pre>  a  b</pre> c"), "split pre");
+  const char *split_comment[] = {"a <!--  ", "  --> b", NULL};
+  check(minifies_to(split_comment, "a <!--    --> b"), "split comment");
+
+  if (0 != testFailed) {
+    return EXIT_FAILURE;
+  }
+
+  printf("minify: raw elements are kept and comments dropped\n");
+  return EXIT_SUCCESS;
+}
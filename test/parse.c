@@ -0,0 +1,134 @@
+// MIT License
+//
+// Copyright (c) 2024 Alessandro Salerno
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Translates the same sources with the stream and the buffer front ends
+// and checks that they produce the same code, or both fail
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "parse.h"
+
+typedef struct {
+  const char *name;
+  const char *src;
+} test_case_t;
+
+static const test_case_t testCases[] = {
+    {"markup only", "<p>hello</p>\n"},
+    {"statement", "<p><?c int x = 1; ?></p>"},
+    {"expression", "<b><?= 1 + 2 ?></b>"},
+    {"no semicolon", "<?c if (1) { ?>yes<?c } ?>"},
+    {"string", "<?c htmc_puts(\"?>\"); ?>"},
+    {"escaped quote", "<?c htmc_puts(\"\\\"?>\"); ?>"},
+    {"char literal", "<?c char c = '?'; char d = '>'; char e = '\\''; ?>"},
+    {"block comment", "<?c /* ?> */ int x; ?>"},
+    {"comment chars", "<?c /*/ ?> */ int x; ?>"},
+    {"line comment", "<?c int x; // comment ?>after"},
+    {"multiple lines", "<?c\nint x;\n\nint y; \n?>\n<p>\n</p>"},
+    {"line continuation", "<?c htmc_puts(\"a\\\nb\"); ?>"},
+    {"ternary", "<?= 1 ? 2 : 3 ?>"},
+    {"nested scopes", "<?c { { int x; } } ?>"},
+    {"end of main scope", "<?c } ?>"},
+    {"unterminated", "<?c int x;"},
+    {"unterminated string", "<?c htmc_puts(\"?>"},
+    {"not a tag", "<? <?i <?inc <?x a < b ?>"},
+    {"profile", "<?profile \"fast\" ?><p></p>"},
+    {"malformed directive", "<?include missing ?>"},
+    {"printf", "<?c htmc_printf(\"%d items\", n); ?>"},
+};
+
+static bool translate(const char *src, bool buffer, char **out, int *ret) {
+  size_t out_len = 0;
+  FILE  *dst     = open_memstream(out, &out_len);
+  if (NULL == dst) {
+    return false;
+  }
+
+  if (buffer) {
+    *ret = parse_and_emit_buffer(src, strlen(src), dst);
+  } else {
+    FILE *src_file = fmemopen((void *)src, strlen(src), "r");
+    if (NULL == src_file) {
+      fclose(dst);
+      return false;
+    }
+
+    *ret = parse_and_emit_stream(src_file, dst);
+    fclose(src_file);
+  }
+
+  return 0 == fclose(dst);
+}
+
+static int run_cases(const char *mode) {
+  int failed = 0;
+
+  for (size_t i = 0; i < sizeof testCases / sizeof(test_case_t); i++) {
+    char *stream_out = NULL;
+    char *buffer_out = NULL;
+    int   stream_ret = 0;
+    int   buffer_ret = 0;
+
+    bool ok = translate(testCases[i].src, false, &stream_out, &stream_ret) &&
+              translate(testCases[i].src, true, &buffer_out, &buffer_ret);
+
+    // Output of failed translations is discarded
+    ok = ok && stream_ret == buffer_ret &&
+         (0 != stream_ret || 0 == strcmp(stream_out, buffer_out));
+
+    if (!ok) {
+      printf("FAIL parse %s: %s\n", mode, testCases[i].name);
+      failed++;
+    }
+
+    free(stream_out);
+    free(buffer_out);
+  }
+
+  return failed;
+}
+
+int main() {
+  log_set_level(HTMC_LOG_LEVEL_OFF);
+  log_set_safe();
+
+  int failed = run_cases("default");
+
+  parse_set_option(PARSE_OPT_SPECIALIZE_PRINTF);
+  parse_set_option(PARSE_OPT_MINIFY);
+  failed += run_cases("-sp -m");
+
+  if (0 != failed) {
+    return EXIT_FAILURE;
+  }
+
+  printf("parse: stream and buffer front ends agree\n");
+  return EXIT_SUCCESS;
+}